@@ -1,9 +1,9 @@
 #include "mnu_alarm.hh"
 #include "alerts_agent.hh"
+#include "alerts_clock.hh"
 
 #include <base/nugu_log.h>
 #include <json/json.h>
-#include <unistd.h>
 
 #define DIR1                                         \
     "{"                                              \
@@ -131,12 +131,13 @@ static int run_test1(Stackmenu* mm, StackmenuItem* menu, void* user_data)
 static int run_test2(Stackmenu* mm, StackmenuItem* menu, void* user_data)
 {
     Json::Value root;
-    AlertsAgent agent;
+    AlertsVirtualClock clock((uint64_t)time(NULL) * 1000);
+    AlertsAgent agent(&clock);
     char buf[255];
     struct tm now_tm;
     time_t now;
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 3;
 
     localtime_r(&now, &now_tm);
@@ -154,7 +155,8 @@ static int run_test2(Stackmenu* mm, StackmenuItem* menu, void* user_data)
 
     agent.addAlert(root);
 
-    sleep(5);
+    /* fire the alert 3 secs later without waiting */
+    clock.advance(5000);
 
     return 0;
 }
@@ -30,8 +30,22 @@ using namespace NuguClientKit;
 
 typedef struct _AlertItem AlertItem;
 
+/* generation-checked reference to an AlertItem (0: invalid) */
+typedef uint64_t AlertHandle;
+
+/* generation-checked id of a timer on the alerts clock (0: invalid) */
+typedef uint64_t AlertTimerId;
+
+class AlertsClock;
 class AlertsManager;
 
+/* size of the Alerts context attached to the events */
+typedef struct _AlertsContextStats {
+    size_t events; /* number of the context requests */
+    size_t last_bytes; /* serialized size of the current context */
+    size_t total_bytes; /* sum of the context size of all events */
+} AlertsContextStats;
+
 class IAlertsManagerListener {
 public:
     virtual ~IAlertsManagerListener() = default;
@@ -72,6 +86,8 @@ class AlertsAgent : public Capability,
                     public IAlertsManagerListener {
 public:
     AlertsAgent();
+    /* alerts driven by the clock (e.g. AlertsVirtualClock). not owned */
+    explicit AlertsAgent(AlertsClock* clock);
     virtual ~AlertsAgent();
 
     void initialize() override;
@@ -82,20 +98,40 @@ public:
     void updateInfoForContext(Json::Value& ctx) override;
 
     bool addAlert(const Json::Value& item);
+    /* all or nothing (one scheduling pass) */
+    bool addAlerts(const Json::Value& items);
+
+    /* Binary snapshot of the alerts (fast restore at boot) */
+    bool saveAlerts(const std::string& path);
+    bool restoreAlerts(const std::string& path);
+
+    /* Restore from the snapshot + journal and log all the changes */
+    bool enableJournal(const std::string& path);
     bool removeAlert(const std::string& token);
 
     Json::Value getAlertList();
     int getAlertCount();
     void resetAlerts();
 
+    /* maxAlarmCount and maxAlertCount of the context (default: 50, 52) */
+    bool setAlertCapacity(int max_alarms, int max_alerts);
+
     void stopSound(const std::string& reason, bool keep_playstack = false);
     bool isAlertPlaying();
 
     void setEnable(bool flag);
     bool isEnable();
 
+    /**
+     * Context with the required fields only (without assets,
+     * playStackControl, ...) instead of the original directives.
+     */
+    void setContextProjection(bool flag);
+    AlertsContextStats getContextStats();
+
 private:
     void releaseFocus();
+    void buildContext();
     void playSound();
     void complete(AlertItem* item, bool start_snooze_timer = true);
     void addPendingIgnored(AlertItem* item);
@@ -136,8 +172,8 @@ private:
     void onAssetRequireTimeout(const std::string& token) override;
     void onDurationTimeout(const std::string& token) override;
 
-    static gboolean onSnoozeAvailabilityTimeout(gpointer userdata);
-    static gboolean onIgnoreTimeout(gpointer userdata);
+    static void onSnoozeAvailabilityTimeout(void* userdata);
+    static void onIgnoreTimeout(void* userdata);
 
     std::string playstackctl_ps_id;
     FocusState focus_state;
@@ -151,18 +187,27 @@ private:
 
     struct {
         std::string token;
+        AlertHandle handle;
         std::string type;
         std::string ps_id;
         NuguCapability::AlertsAudioPlayer* audioplayer;
     } cur;
 
     std::string active_alarm_token;
-    guint snooze_availability_timer;
+    AlertTimerId snooze_availability_timer;
     std::map<std::string, std::vector<std::string>> ignore_list;
-    guint ignore_timer;
+    AlertTimerId ignore_timer;
 
     std::string routine_payload;
     std::string routine_dialog_id;
+
+    /* Alerts context cache (rebuilt only if the alert list is changed) */
+    Json::Value context_static;
+    Json::Value context_cache;
+    uint64_t context_version;
+    std::string context_active_token;
+    bool context_projection;
+    AlertsContextStats context_stats;
 };
 
 #endif /* __NUGU_ALERTS_AGENT_H__ */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NUGU_ALERTS_CLOCK_H__
+#define __NUGU_ALERTS_CLOCK_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include <memory>
+
+class IAlertsClockListener {
+public:
+    virtual ~IAlertsClockListener() = default;
+
+    /* the armed deadline has passed */
+    virtual void onClockTimer() = 0;
+
+    /* the realtime clock was set (NTP step, manual change, ...) */
+    virtual void onClockChanged() = 0;
+};
+
+/**
+ * Time source and timer of the AlertsManager
+ *  - CLOCK_REALTIME (wall clock) and CLOCK_MONOTONIC
+ *  - one absolute realtime deadline armed by the listener
+ */
+class AlertsClock {
+public:
+    virtual ~AlertsClock() = default;
+
+    virtual void getTime(clockid_t clock_id, struct timespec* ts) = 0;
+
+    /* nullptr: no more callbacks after return */
+    virtual void setListener(IAlertsClockListener* listener) = 0;
+
+    /* wake up at the realtime deadline (0: disarm) */
+    virtual void arm(uint64_t expire_msec) = 0;
+
+    /**
+     * true: the callbacks are called in the context moving the clock
+     * (the owner context). false: in the timer thread.
+     */
+    virtual bool isSynchronous() = 0;
+
+    uint64_t getMsec(clockid_t clock_id);
+    uint64_t realtimeMsec();
+    uint64_t monotonicMsec();
+};
+
+struct AlertsTimerClient;
+
+/**
+ * clock_gettime() and the deadline of the process-wide timer service
+ * (one timer thread and one CLOCK_REALTIME timerfd for all the clocks).
+ * The timer thread is started on the first arm().
+ */
+class AlertsSystemClock : public AlertsClock {
+public:
+    AlertsSystemClock();
+    virtual ~AlertsSystemClock();
+
+    void getTime(clockid_t clock_id, struct timespec* ts) override;
+    void setListener(IAlertsClockListener* listener) override;
+    void arm(uint64_t expire_msec) override;
+    bool isSynchronous() override;
+
+private:
+    std::shared_ptr<AlertsTimerClient> client;
+};
+
+/**
+ * Deterministic time for the tests and the simulations
+ *  - the time moves only by advance() and setRealtime()
+ *  - the deadlines are fired in the caller of advance() (synchronous
+ *    unless setSynchronous(false)),
+ *    so a year of alarms can be simulated without waiting
+ */
+class AlertsVirtualClock : public AlertsClock {
+public:
+    explicit AlertsVirtualClock(uint64_t realtime_msec);
+    virtual ~AlertsVirtualClock() = default;
+
+    void getTime(clockid_t clock_id, struct timespec* ts) override;
+    void setListener(IAlertsClockListener* listener) override;
+    void arm(uint64_t expire_msec) override;
+    bool isSynchronous() override;
+
+    /* move both clocks forward and fire the deadlines on the way */
+    void advance(uint64_t msec);
+
+    /* set the realtime clock only (clock change) */
+    void setRealtime(uint64_t msec);
+
+    /**
+     * false: the owner drains the commands of the callbacks later from its
+     * main loop (e.g. a clock step between the fire and the dispatch)
+     */
+    void setSynchronous(bool flag);
+
+private:
+    IAlertsClockListener* listener;
+    uint64_t realtime;
+    uint64_t monotonic;
+    uint64_t armed_msec;
+    bool synchronous;
+};
+
+#endif
@@ -27,18 +27,6 @@
 #include <string>
 #include <vector>
 
-/**
- * Maximum number of ALARM type alerts.
- * Must have a value less than MAX_ALERTS
- */
-#define MAX_ALARM 50
-
-/**
- * Maximum number of alerts(including ALARM type).
- * MAX_ALARM + (1 TIMER + 1 SLEEP)
- */
-#define MAX_ALERTS (MAX_ALARM + 2)
-
 /**
  * Snooze is still possible for 30 seconds after the alarm ends.
  */
@@ -50,8 +38,16 @@ static const char* CAPABILITY_NAME = "Alerts";
 static const char* CAPABILITY_VERSION = "1.1";
 
 AlertsAgent::AlertsAgent()
+    : AlertsAgent(nullptr)
+{
+}
+
+AlertsAgent::AlertsAgent(AlertsClock* clock)
     : Capability(CAPABILITY_NAME, CAPABILITY_VERSION)
-    , manager(new AlertsManager())
+    , manager(new AlertsManager(clock))
+    , context_version(0)
+    , context_projection(false)
+    , context_stats()
 {
     directive_for_sync = nugu_directive_new("Alerts", "SetAlert",
         CAPABILITY_VERSION, "", "", "", "{}",
@@ -97,6 +93,7 @@ void AlertsAgent::initialize()
     routine_dialog_id.clear();
 
     cur.token = "";
+    cur.handle = 0;
     cur.audioplayer = nullptr;
 }
 
@@ -106,12 +103,12 @@ void AlertsAgent::deInitialize()
         stopSound("deInitialize");
 
     if (snooze_availability_timer) {
-        g_source_remove(snooze_availability_timer);
+        manager->removeTimeout(snooze_availability_timer);
         snooze_availability_timer = 0;
     }
 
     if (ignore_timer) {
-        g_source_remove(ignore_timer);
+        manager->removeTimeout(ignore_timer);
         ignore_timer = 0;
     }
 
@@ -120,6 +117,7 @@ void AlertsAgent::deInitialize()
     is_enable = false;
 
     cur.token = "";
+    cur.handle = 0;
 }
 
 void AlertsAgent::setCapabilityListener(ICapabilityListener* clistener)
@@ -181,33 +179,67 @@ void AlertsAgent::parsingDirective(const char* dname, const char* message)
     }
 }
 
-void AlertsAgent::updateInfoForContext(Json::Value& ctx)
+void AlertsAgent::buildContext()
 {
-    Json::Value alerts;
-
-    alerts["version"] = getVersion();
-    alerts["maxAlertCount"] = MAX_ALERTS;
-    alerts["maxAlarmCount"] = MAX_ALARM;
-    alerts["supportedTypes"][0] = "TIMER";
-    alerts["supportedTypes"][1] = "ALARM";
-    alerts["supportedTypes"][2] = "SLEEP";
-    alerts["supportedTypes"][3] = "ACTION";
-    alerts["supportedAlarmResourceTypes"][0] = "INTERNAL";
-    alerts["supportedAlarmResourceTypes"][1] = "MUSIC";
-    alerts["supportedAlarmResourceTypes"][2] = "TTS";
-    alerts["internalAlarms"][0]["BASIC"] = "기본 알람음";
-
-    Json::Value allAlerts = manager->getAlertList(true);
+    /* static part (built once) */
+    if (context_static.isNull()) {
+        context_static["version"] = getVersion();
+        context_static["maxAlertCount"] = (Json::UInt)manager->getMaxAlertCount();
+        context_static["maxAlarmCount"] = (Json::UInt)manager->getMaxAlarmCount();
+        context_static["supportedTypes"][0] = "TIMER";
+        context_static["supportedTypes"][1] = "ALARM";
+        context_static["supportedTypes"][2] = "SLEEP";
+        context_static["supportedTypes"][3] = "ACTION";
+        context_static["supportedAlarmResourceTypes"][0] = "INTERNAL";
+        context_static["supportedAlarmResourceTypes"][1] = "MUSIC";
+        context_static["supportedAlarmResourceTypes"][2] = "TTS";
+        context_static["internalAlarms"][0]["BASIC"] = "기본 알람음";
+    }
+
+    context_cache = context_static;
+
+    Json::Value allAlerts = context_projection ? manager->getContextAlertList() : manager->getAlertList(true);
     if (allAlerts.empty()) {
-        alerts["allAlerts"] = Json::Value(Json::arrayValue);
+        context_cache["allAlerts"] = Json::Value(Json::arrayValue);
     } else {
-        alerts["allAlerts"] = allAlerts;
+        context_cache["allAlerts"].swap(allAlerts);
     }
 
     if (active_alarm_token != "")
-        alerts["activeAlarmToken"] = active_alarm_token;
+        context_cache["activeAlarmToken"] = active_alarm_token;
 
-    ctx[getName()] = alerts;
+    context_version = manager->getVersion();
+    context_active_token = active_alarm_token;
+
+    Json::FastWriter writer;
+    context_stats.last_bytes = writer.write(context_cache).size();
+}
+
+void AlertsAgent::updateInfoForContext(Json::Value& ctx)
+{
+    if (context_version != manager->getVersion() || context_active_token != active_alarm_token)
+        buildContext();
+
+    ctx[getName()] = context_cache;
+
+    context_stats.events++;
+    context_stats.total_bytes += context_stats.last_bytes;
+}
+
+void AlertsAgent::setContextProjection(bool flag)
+{
+    if (context_projection == flag)
+        return;
+
+    context_projection = flag;
+
+    /* rebuild on the next request */
+    context_version = 0;
+}
+
+AlertsContextStats AlertsAgent::getContextStats()
+{
+    return context_stats;
 }
 
 void AlertsAgent::sendEventSetAlertSucceeded(const std::string& ps_id, const std::string& token)
@@ -314,49 +346,43 @@ void AlertsAgent::sendEventCommon(const std::string& ename, const std::string& p
 
 void AlertsAgent::parsingSetAlert(const char* message)
 {
-    Json::Value root;
-    Json::Reader reader;
-    std::string ps_id;
-    std::string token;
-    std::string type;
-    std::string schedule_time;
+    AlertsSetAlertDirective directive;
 
-    if (!reader.parse(message, root)) {
+    if (!AlertsDirectiveParser::parseSetAlert(message, strlen(message), &directive)) {
         nugu_error("parsing error");
         return;
     }
 
-    ps_id = root["playServiceId"].asString();
-    token = root["token"].asString();
-    type = root["alertType"].asString();
-    schedule_time = root["scheduledTime"].asString();
+    const std::string& ps_id = directive.ps_id;
+    const std::string& token = directive.token;
+    const std::string& type = directive.type;
 
     if (ps_id.size() == 0 || token.size() == 0 || type.size() == 0
-        || schedule_time.size() == 0 || root["activation"].empty()) {
+        || directive.scheduled_time.size() == 0 || !directive.has_activation) {
         nugu_error("There is no mandatory data in directive message");
         return;
     }
 
-    if ((type == "ALARM" || type == "ACTION") && root["assets"].empty()) {
+    if ((type == "ALARM" || type == "ACTION") && !directive.has_assets) {
         nugu_error("There is no mandatory data in directive message");
         sendEventSetAlertFailed(ps_id, token);
         return;
     }
 
 #ifdef IGNORE_TEST
-    /* To make the ignore test easier, the seconds of the time are always set to zero. */
-    if (schedule_time.size() > 18) {
-        nugu_error("before: %s", schedule_time.c_str());
-        schedule_time.at(17) = '0';
-        schedule_time.at(18) = '0';
-        nugu_error("after:  %s", schedule_time.c_str());
-        root["scheduledTime"] = schedule_time;
+    /* To make the ignore test easier, the seconds of the time are always set to zero.
+     * (the original message is kept as it is) */
+    if (directive.scheduled_time.size() > 18) {
+        nugu_error("before: %s", directive.scheduled_time.c_str());
+        directive.scheduled_time.at(17) = '0';
+        directive.scheduled_time.at(18) = '0';
+        nugu_error("after:  %s", directive.scheduled_time.c_str());
     }
 #endif
 
     nugu_info("parsingSetAlert");
 
-    AlertItem* alert = manager->generateAlert(root);
+    AlertItem* alert = manager->generateAlert(directive);
     if (!alert) {
         nugu_error("internal error");
         sendEventSetAlertFailed(ps_id, token);
@@ -380,6 +406,13 @@ void AlertsAgent::parsingSetAlert(const char* message)
         return;
     }
 
+    if (manager->isFull(alert)) {
+        delete alert;
+        nugu_error("over the capacity (alarms: %zu, alerts: %zu)", manager->getMaxAlarmCount(), manager->getMaxAlertCount());
+        sendEventSetAlertFailed(ps_id, token);
+        return;
+    }
+
     if (manager->addItem(alert) == false) {
         delete alert;
         nugu_error("setAlerts failed");
@@ -397,8 +430,12 @@ void AlertsAgent::parsingSetAlert(const char* message)
         alerts_listener->onSetAlert(message, type);
 
     // add to play context stack
-    if (root.isMember("playStackControl")) {
-        playstackctl_ps_id = getPlayServiceIdInStackControl(root["playStackControl"]);
+    if (directive.playstack_control) {
+        Json::Value playstack_control;
+        Json::Reader reader;
+
+        if (reader.parse(directive.playstack_control, directive.playstack_control + directive.playstack_control_length, playstack_control))
+            playstackctl_ps_id = getPlayServiceIdInStackControl(playstack_control);
     }
 
     sendEventSetAlertSucceeded(ps_id, token);
@@ -406,20 +443,16 @@ void AlertsAgent::parsingSetAlert(const char* message)
 
 void AlertsAgent::parsingDeleteAlerts(const char* message)
 {
-    Json::Value root;
-    Json::Reader reader;
-    Json::Value tokens;
-    std::string ps_id;
-    std::vector<std::string> list_success;
-    std::vector<std::string> list_failed;
+    AlertsDeleteAlertsDirective directive;
+    AlertsTransaction txn;
 
-    if (!reader.parse(message, root)) {
+    if (!AlertsDirectiveParser::parseDeleteAlerts(message, strlen(message), &directive)) {
         nugu_error("parsing error");
         return;
     }
 
-    ps_id = root["playServiceId"].asString();
-    tokens = root["tokens"];
+    const std::string& ps_id = directive.ps_id;
+    const std::vector<std::string>& tokens = directive.tokens;
 
     if (ps_id.size() == 0 || tokens.empty()) {
         nugu_error("There is no mandatory data in directive message");
@@ -428,31 +461,34 @@ void AlertsAgent::parsingDeleteAlerts(const char* message)
 
     nugu_info("parsingDeleteAlerts");
 
-    nugu_dbg("remove %d alarms", tokens.size());
+    nugu_dbg("remove %zd alarms", tokens.size());
 
-    for (int i = 0; i < (int)tokens.size(); i++) {
-        std::string token = tokens[i].asString();
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const std::string& token = tokens[i];
 
-        nugu_info("remove %d/%d: %s", i + 1, tokens.size(), token.c_str());
+        nugu_info("remove %zd/%zd: %s", i + 1, tokens.size(), token.c_str());
 
         if (active_alarm_token == token) {
             active_alarm_token = "";
             if (snooze_availability_timer) {
-                g_source_remove(snooze_availability_timer);
+                manager->removeTimeout(snooze_availability_timer);
                 snooze_availability_timer = 0;
             }
         }
 
-        if (removeAlert(token) == true)
-            list_success.push_back(token);
-        else
-            list_failed.push_back(token);
+        txn.remove(token);
+    }
 
-        if (alerts_listener)
-            alerts_listener->onAlertDelete(token);
+    /* remove all tokens with one scheduling pass */
+    manager->commit(txn);
+
+    if (alerts_listener) {
+        for (auto const& entry : txn.getEntries())
+            alerts_listener->onAlertDelete(entry.token);
     }
 
-    manager->dump();
+    std::vector<std::string> list_success = txn.getTokens(AlertsTransaction::OP_REMOVE, true);
+    std::vector<std::string> list_failed = txn.getTokens(AlertsTransaction::OP_REMOVE, false);
 
     if (list_success.size() > 0)
         sendEventDeleteAlertsSucceeded(ps_id, list_success);
@@ -466,22 +502,17 @@ void AlertsAgent::parsingDeleteAlerts(const char* message)
 
 void AlertsAgent::parsingDeliveryAlertAsset(const char* message)
 {
-    Json::Value root;
-    Json::Reader reader;
-    Json::StyledWriter writer;
-    Json::Value asset_detail;
-    std::string token;
-    std::string ps_id;
+    AlertsDeliveryAlertAssetDirective directive;
 
-    if (!reader.parse(message, root)) {
+    if (!AlertsDirectiveParser::parseDeliveryAlertAsset(message, strlen(message), &directive)) {
         nugu_error("parsing error");
         return;
     }
 
-    ps_id = root["playServiceId"].asString();
-    token = root["token"].asString();
+    const std::string& ps_id = directive.ps_id;
+    const std::string& token = directive.token;
 
-    if (ps_id.size() == 0 || token.size() == 0 || root["assetDetails"].empty()) {
+    if (ps_id.size() == 0 || token.size() == 0 || directive.asset_details.empty()) {
         nugu_error("There is no mandatory data in directive message");
         return;
     }
@@ -494,42 +525,40 @@ void AlertsAgent::parsingDeliveryAlertAsset(const char* message)
         return;
     }
 
-    asset_detail = root["assetDetails"];
-
-    for (int i = 0; i < (int)asset_detail.size(); i++) {
-        Json::Value asset = asset_detail[i];
-        Json::Value header = asset["header"];
-        Json::Value payload = asset["payload"];
+    for (auto const& asset : directive.asset_details) {
         std::string type;
 
-        if (header.empty() || payload.empty()) {
+        if (!asset.has_header || !asset.has_payload) {
             nugu_error("There is no header or payload");
             continue;
         }
 
-        type = header["namespace"].asString() + "." + header["name"].asString();
+        /* the payload is passed as the original text */
+        std::string payload(asset.payload, asset.payload_length);
+
+        type = asset.name_space + "." + asset.name;
         nugu_dbg("asset namespace: %s", type.c_str());
 
         if (type == "Routine.Start") {
-            routine_dialog_id = header["dialogRequestId"].asString();
-            routine_payload = writer.write(payload);
+            routine_dialog_id = asset.dialog_request_id;
+            routine_payload = payload;
             continue;
         }
 
-        if (item->audioplayer == nullptr) {
+        if (item->payload->audioplayer == nullptr) {
             nugu_dbg("create audioplayer for %s", token.c_str());
-            item->audioplayer = new AlertsAudioPlayer();
-            item->audioplayer->setNuguCoreContainer(core_container);
-            item->audioplayer->initialize();
-            item->audioplayer->addListener(this);
+            item->payload->audioplayer = new AlertsAudioPlayer();
+            item->payload->audioplayer->setNuguCoreContainer(core_container);
+            item->payload->audioplayer->initialize();
+            item->payload->audioplayer->addListener(this);
         }
 
         if (type == "TTS.Attachment") {
             destroy_directive_by_agent = true;
-            item->audioplayer->setNuguDirective(getNuguDirective());
+            item->payload->audioplayer->setNuguDirective(getNuguDirective());
         } else if (type == "AudioPlayer.Play") {
-            item->audioplayer->setNuguDirective(getNuguDirective());
-            item->audioplayer->parsingDirective(header["name"].asCString(), writer.write(payload).c_str());
+            item->payload->audioplayer->setNuguDirective(getNuguDirective());
+            item->payload->audioplayer->parsingDirective(asset.name.c_str(), payload.c_str());
         } else {
             nugu_warn("%s is not support", type.c_str());
             continue;
@@ -539,27 +568,24 @@ void AlertsAgent::parsingDeliveryAlertAsset(const char* message)
 
 void AlertsAgent::parsingSetSnooze(const char* message)
 {
-    Json::Value root;
-    Json::Reader reader;
-    std::string token;
-    std::string ps_id;
+    AlertsSetSnoozeDirective directive;
     int duration_sec;
 
-    if (!reader.parse(message, root)) {
+    if (!AlertsDirectiveParser::parseSetSnooze(message, strlen(message), &directive)) {
         nugu_error("parsing error");
         return;
     }
 
-    ps_id = root["playServiceId"].asString();
-    token = root["token"].asString();
+    const std::string& ps_id = directive.ps_id;
+    const std::string& token = directive.token;
 
-    if (ps_id.size() == 0 || token.size() == 0 || root["durationInSec"].empty()) {
+    if (ps_id.size() == 0 || token.size() == 0 || !directive.has_duration) {
         nugu_error("There is no mandatory data in directive message");
         sendEventSetSnoozeFailed(ps_id, token);
         return;
     }
 
-    duration_sec = root["durationInSec"].asInt();
+    duration_sec = (int)directive.duration_sec;
     if (duration_sec <= 0) {
         nugu_error("There is no mandatory data in directive message");
         sendEventSetSnoozeFailed(ps_id, token);
@@ -575,16 +601,7 @@ void AlertsAgent::parsingSetSnooze(const char* message)
 
     nugu_info("set snooze! (%d secs)", duration_sec);
 
-    /* Clear previous snooze */
-    if (item->timer_src != 0 || item->snooze_secs != 0) {
-        nugu_dbg("clear previous timer source");
-        manager->done(item);
-    }
-
-    /* Enable the is_activated flag to scheduling (without JSON update) */
-    item->is_activated = true;
-    item->snooze_secs = duration_sec;
-
+    manager->snooze(item, duration_sec);
     manager->scheduling();
     manager->dump();
 
@@ -604,7 +621,7 @@ void AlertsAgent::mediaStateChanged(NuguCapability::AudioPlayerState state, cons
         return;
     }
 
-    AlertItem* item = manager->findItem(cur.token);
+    AlertItem* item = manager->getItem(cur.handle);
     if (!item) {
         nugu_error("can't find the alert item");
         return;
@@ -619,7 +636,7 @@ void AlertsAgent::mediaStateChanged(NuguCapability::AudioPlayerState state, cons
         item->duration_timer_src = manager->addDurationTimeout(item->duration_secs, item->token);
 
         if (alerts_listener)
-            alerts_listener->onFilePlayRequest(item->token, item->type_str, item->rsrc_type);
+            alerts_listener->onFilePlayRequest(item->token, item->payload->type_str, item->payload->rsrc_type);
     } else {
         nugu_info("finished!! releasefocus");
         releaseFocus();
@@ -651,7 +668,7 @@ void AlertsAgent::durationChanged(int duration)
     if (cur.token == "")
         return;
 
-    AlertItem* item = manager->findItem(cur.token);
+    AlertItem* item = manager->getItem(cur.handle);
     if (!item) {
         nugu_error("can't find the alert item");
         return;
@@ -680,7 +697,7 @@ void AlertsAgent::durationChanged(int duration)
     item->duration_timer_src = manager->addDurationTimeout(duration + 1, item->token);
 }
 
-/* callback in thread context */
+/* callback in the owner (main loop) context */
 void AlertsAgent::onTimeout(const std::string& token)
 {
     nugu_info("timeout! %s", token.c_str());
@@ -716,7 +733,7 @@ void AlertsAgent::onTimeout(const std::string& token)
     }
 
     if (snooze_availability_timer) {
-        g_source_remove(snooze_availability_timer);
+        manager->removeTimeout(snooze_availability_timer);
         snooze_availability_timer = 0;
     }
 
@@ -724,7 +741,7 @@ void AlertsAgent::onTimeout(const std::string& token)
 
     if (item->has_routine) {
         auto fail_handler([&](std::string&& error_code) {
-            sendEventAlertFailed(item->ps_id, item->token, error_code);
+            sendEventAlertFailed(item->payload->ps_id, item->token, error_code);
         });
 
         alerts_listener ? alerts_listener->onRoutineActivate(routine_dialog_id, routine_payload, fail_handler)
@@ -735,6 +752,7 @@ void AlertsAgent::onTimeout(const std::string& token)
 
     if (cur.token == "") {
         cur.token = item->token;
+        cur.handle = item->handle;
 
         if (item->type == ALERT_TYPE_ALARM)
             active_alarm_token = item->token;
@@ -757,6 +775,7 @@ void AlertsAgent::onTimeout(const std::string& token)
         }
 
         cur.token = item->token;
+        cur.handle = item->handle;
 
         if (item->type == ALERT_TYPE_ALARM)
             active_alarm_token = item->token;
@@ -765,7 +784,7 @@ void AlertsAgent::onTimeout(const std::string& token)
     }
 }
 
-/* callback in thread context */
+/* callback in the owner (main loop) context */
 void AlertsAgent::onAssetRequireTimeout(const std::string& token)
 {
     nugu_info("asset timeout! %s", token.c_str());
@@ -776,11 +795,11 @@ void AlertsAgent::onAssetRequireTimeout(const std::string& token)
         return;
     }
 
-    if (item->rsrc_type == "MUSIC" || item->rsrc_type == "TTS" || item->has_routine)
-        sendEventAlertAssetRequired(item->ps_id, item->token);
+    if (item->rsrc == ALERT_RESOURCE_MUSIC || item->rsrc == ALERT_RESOURCE_TTS || item->has_routine)
+        sendEventAlertAssetRequired(item->payload->ps_id, item->token);
 }
 
-/* callback in thread context */
+/* callback in the owner (main loop) context */
 void AlertsAgent::onDurationTimeout(const std::string& token)
 {
     nugu_info("duration timeout! %s", token.c_str());
@@ -799,6 +818,31 @@ bool AlertsAgent::addAlert(const Json::Value& item)
     return manager->add(item);
 }
 
+bool AlertsAgent::addAlerts(const Json::Value& items)
+{
+    AlertsTransaction txn;
+
+    for (int i = 0; i < (int)items.size(); i++)
+        txn.add(items[i]);
+
+    return manager->commit(txn);
+}
+
+bool AlertsAgent::saveAlerts(const std::string& path)
+{
+    return manager->saveSnapshot(path);
+}
+
+bool AlertsAgent::restoreAlerts(const std::string& path)
+{
+    return manager->loadSnapshot(path);
+}
+
+bool AlertsAgent::enableJournal(const std::string& path)
+{
+    return manager->openJournal(path);
+}
+
 bool AlertsAgent::removeAlert(const std::string& token)
 {
     if (manager->findItem(token) == nullptr)
@@ -826,6 +870,7 @@ void AlertsAgent::resetAlerts()
         stopSound("resetAlerts");
 
     cur.token = "";
+    cur.handle = 0;
     manager->reset();
 }
 
@@ -834,6 +879,21 @@ int AlertsAgent::getAlertCount()
     return manager->getAlertCount();
 }
 
+bool AlertsAgent::setAlertCapacity(int max_alarms, int max_alerts)
+{
+    if (max_alarms <= 0 || max_alerts <= 0)
+        return false;
+
+    if (!manager->setCapacity(max_alarms, max_alerts))
+        return false;
+
+    /* rebuild the static part on the next request */
+    context_static = Json::Value();
+    context_version = 0;
+
+    return true;
+}
+
 void AlertsAgent::setEnable(bool flag)
 {
     is_enable = flag;
@@ -851,21 +911,21 @@ void AlertsAgent::playSound()
         return;
     }
 
-    AlertItem* item = manager->findItem(cur.token);
+    AlertItem* item = manager->getItem(cur.handle);
     if (!item) {
         nugu_error("can't find the current alert");
         return;
     }
 
-    cur.type = item->type_str;
-    cur.ps_id = item->ps_id;
+    cur.type = item->payload->type_str;
+    cur.ps_id = item->payload->ps_id;
 
     nugu_info("playSound type: %s", cur.type.c_str());
 
     sendEventAlertStarted(cur.ps_id, cur.token);
 
     if (alerts_listener)
-        alerts_listener->onAlertStart(item->token, item->type_str, item->rsrc_type);
+        alerts_listener->onAlertStart(item->token, item->payload->type_str, item->payload->rsrc_type);
 
     if (!playstackctl_ps_id.empty()) {
         playsync_manager->prepareSync(playstackctl_ps_id, directive_for_sync);
@@ -876,32 +936,32 @@ void AlertsAgent::playSound()
 
     if (item->type == ALERT_TYPE_TIMER) {
         if (alerts_listener)
-            alerts_listener->onFilePlayRequest(item->token, item->type_str, item->rsrc_type);
+            alerts_listener->onFilePlayRequest(item->token, item->payload->type_str, item->payload->rsrc_type);
     } else if (item->type == ALERT_TYPE_ALARM) {
         bool use_file = true;
 
-        if (item->rsrc_type == "MUSIC") {
-            if (item->audioplayer && item->audioplayer->playMedia()) {
+        if (item->rsrc == ALERT_RESOURCE_MUSIC) {
+            if (item->payload->audioplayer && item->payload->audioplayer->playMedia()) {
                 use_file = false;
-                cur.audioplayer = item->audioplayer;
-                item->audioplayer = nullptr;
+                cur.audioplayer = item->payload->audioplayer;
+                item->payload->audioplayer = nullptr;
             } else {
                 nugu_error("playMedia() failed");
             }
-        } else if (item->rsrc_type == "TTS") {
-            if (item->audioplayer && item->audioplayer->playTTS()) {
+        } else if (item->rsrc == ALERT_RESOURCE_TTS) {
+            if (item->payload->audioplayer && item->payload->audioplayer->playTTS()) {
                 use_file = false;
-                cur.audioplayer = item->audioplayer;
-                item->audioplayer = nullptr;
+                cur.audioplayer = item->payload->audioplayer;
+                item->payload->audioplayer = nullptr;
             } else {
                 nugu_error("playTTS() failed");
             }
-        } else if (item->rsrc_type != "INTERNAL") {
-            nugu_error("unknown resource type: %s", item->rsrc_type.c_str());
+        } else if (item->rsrc != ALERT_RESOURCE_INTERNAL) {
+            nugu_error("unknown resource type: %s", item->payload->rsrc_type.c_str());
         }
 
         if (use_file && alerts_listener)
-            alerts_listener->onFilePlayRequest(item->token, item->type_str, item->rsrc_type);
+            alerts_listener->onFilePlayRequest(item->token, item->payload->type_str, item->payload->rsrc_type);
     } else if (item->type == ALERT_TYPE_SLEEP) {
         playsync_manager->clear();
         focus_manager->stopAllFocus();
@@ -919,7 +979,7 @@ void AlertsAgent::stopSound(const std::string& reason, bool keep_playstack)
         return;
     }
 
-    AlertItem* item = manager->findItem(cur.token);
+    AlertItem* item = manager->getItem(cur.handle);
     if (item)
         complete(item);
 
@@ -929,6 +989,7 @@ void AlertsAgent::stopSound(const std::string& reason, bool keep_playstack)
         alerts_listener->onAlertStop(cur.token, cur.type);
 
     cur.token = "";
+    cur.handle = 0;
 
     if (!playstackctl_ps_id.empty()) {
         if (keep_playstack) {
@@ -943,7 +1004,7 @@ void AlertsAgent::stopSound(const std::string& reason, bool keep_playstack)
         releaseFocus();
 }
 
-gboolean AlertsAgent::onSnoozeAvailabilityTimeout(gpointer userdata)
+void AlertsAgent::onSnoozeAvailabilityTimeout(void* userdata)
 {
     AlertsAgent* agent = (AlertsAgent*)userdata;
 
@@ -951,8 +1012,6 @@ gboolean AlertsAgent::onSnoozeAvailabilityTimeout(gpointer userdata)
 
     agent->active_alarm_token = "";
     agent->snooze_availability_timer = 0;
-
-    return FALSE;
 }
 
 void AlertsAgent::complete(AlertItem* item, bool start_snooze_timer)
@@ -960,7 +1019,7 @@ void AlertsAgent::complete(AlertItem* item, bool start_snooze_timer)
     manager->done(item);
 
     if (snooze_availability_timer) {
-        g_source_remove(snooze_availability_timer);
+        manager->removeTimeout(snooze_availability_timer);
         snooze_availability_timer = 0;
     }
 
@@ -970,7 +1029,7 @@ void AlertsAgent::complete(AlertItem* item, bool start_snooze_timer)
     } else if (start_snooze_timer && active_alarm_token != "") {
         /* Snooze only supports ALARM alerts and is possible only for
          * SNOOZE_AVAILABILITY_SECS seconds after the alarm ends */
-        snooze_availability_timer = g_timeout_add_seconds(SNOOZE_AVAILABILITY_SECS,
+        snooze_availability_timer = manager->addCallbackTimeout(SNOOZE_AVAILABILITY_SECS,
             onSnoozeAvailabilityTimeout, this);
         nugu_info("start snooze availability timer (%d secs)", SNOOZE_AVAILABILITY_SECS);
     }
@@ -979,7 +1038,7 @@ void AlertsAgent::complete(AlertItem* item, bool start_snooze_timer)
     manager->dump();
 }
 
-gboolean AlertsAgent::onIgnoreTimeout(gpointer userdata)
+void AlertsAgent::onIgnoreTimeout(void* userdata)
 {
     AlertsAgent* agent = (AlertsAgent*)userdata;
 
@@ -998,15 +1057,13 @@ gboolean AlertsAgent::onIgnoreTimeout(gpointer userdata)
     }
 
     agent->ignore_list.clear();
-
-    return FALSE;
 }
 
 void AlertsAgent::addPendingIgnored(AlertItem* item)
 {
     if (ignore_timer == 0)
-        ignore_timer = g_timeout_add_seconds(1, onIgnoreTimeout, this);
+        ignore_timer = manager->addCallbackTimeout(1, onIgnoreTimeout, this);
 
     nugu_dbg("add to pending ignored list");
-    ignore_list[item->ps_id].push_back(item->token);
+    ignore_list[item->payload->ps_id].push_back(item->token);
 }
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_clock.hh"
+#include "alerts_timer_service.hh"
+
+uint64_t AlertsClock::getMsec(clockid_t clock_id)
+{
+    struct timespec ts;
+
+    getTime(clock_id, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t AlertsClock::realtimeMsec()
+{
+    return getMsec(CLOCK_REALTIME);
+}
+
+uint64_t AlertsClock::monotonicMsec()
+{
+    return getMsec(CLOCK_MONOTONIC);
+}
+
+AlertsSystemClock::AlertsSystemClock()
+    : client(AlertsTimerService::getInstance().registerClient())
+{
+}
+
+AlertsSystemClock::~AlertsSystemClock()
+{
+    AlertsTimerService::getInstance().unregisterClient(client);
+}
+
+void AlertsSystemClock::getTime(clockid_t clock_id, struct timespec* ts)
+{
+    clock_gettime(clock_id, ts);
+}
+
+void AlertsSystemClock::setListener(IAlertsClockListener* clistener)
+{
+    /* waits for the running callback */
+    AlertsTimerService::getInstance().setListener(client, clistener);
+}
+
+void AlertsSystemClock::arm(uint64_t expire_msec)
+{
+    AlertsTimerService::getInstance().arm(client, expire_msec);
+}
+
+bool AlertsSystemClock::isSynchronous()
+{
+    return false;
+}
+
+AlertsVirtualClock::AlertsVirtualClock(uint64_t realtime_msec)
+    : listener(nullptr)
+    , realtime(realtime_msec)
+    , monotonic(0)
+    , armed_msec(0)
+    , synchronous(true)
+{
+}
+
+void AlertsVirtualClock::getTime(clockid_t clock_id, struct timespec* ts)
+{
+    uint64_t msec = (clock_id == CLOCK_REALTIME) ? realtime : monotonic;
+
+    ts->tv_sec = msec / 1000;
+    ts->tv_nsec = (msec % 1000) * 1000000;
+}
+
+void AlertsVirtualClock::setListener(IAlertsClockListener* clistener)
+{
+    listener = clistener;
+}
+
+void AlertsVirtualClock::arm(uint64_t expire_msec)
+{
+    armed_msec = expire_msec;
+}
+
+bool AlertsVirtualClock::isSynchronous()
+{
+    return synchronous;
+}
+
+void AlertsVirtualClock::setSynchronous(bool flag)
+{
+    synchronous = flag;
+}
+
+void AlertsVirtualClock::advance(uint64_t msec)
+{
+    uint64_t target = realtime + msec;
+
+    /* the listener arms the next deadline in the callback */
+    while (armed_msec != 0 && armed_msec <= target) {
+        if (armed_msec > realtime) {
+            monotonic += armed_msec - realtime;
+            realtime = armed_msec;
+        }
+
+        armed_msec = 0;
+
+        if (listener)
+            listener->onClockTimer();
+    }
+
+    monotonic += target - realtime;
+    realtime = target;
+}
+
+void AlertsVirtualClock::setRealtime(uint64_t msec)
+{
+    realtime = msec;
+
+    /* same as the cancelled timerfd (TFD_TIMER_CANCEL_ON_SET) */
+    armed_msec = 0;
+
+    if (listener)
+        listener->onClockChanged();
+}
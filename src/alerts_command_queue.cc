@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_command_queue.hh"
+
+#include <base/nugu_log.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+AlertsCommandQueue::Command::Command(CommandFunc cfunc, void* cuserdata)
+    : func(cfunc)
+    , userdata(cuserdata)
+    , next(nullptr)
+    , queued(false)
+{
+}
+
+AlertsCommandQueue::AlertsCommandQueue()
+    : head(&stub)
+    , tail(&stub)
+    , signaled(false)
+{
+    event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (event_fd < 0)
+        nugu_error("eventfd failed");
+}
+
+AlertsCommandQueue::~AlertsCommandQueue()
+{
+    if (event_fd >= 0)
+        close(event_fd);
+}
+
+int AlertsCommandQueue::getFd() const
+{
+    return event_fd;
+}
+
+/* Vyukov intrusive MPSC queue */
+void AlertsCommandQueue::push(Command* command)
+{
+    command->next.store(nullptr, std::memory_order_relaxed);
+
+    Command* prev = head.exchange(command, std::memory_order_acq_rel);
+    prev->next.store(command, std::memory_order_release);
+}
+
+/* nullptr if empty (or a producer is in the middle of push) */
+AlertsCommandQueue::Command* AlertsCommandQueue::pop()
+{
+    Command* cur = tail;
+    Command* next = cur->next.load(std::memory_order_acquire);
+
+    if (cur == &stub) {
+        if (next == nullptr)
+            return nullptr;
+
+        tail = next;
+        cur = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        tail = next;
+        return cur;
+    }
+
+    if (cur != head.load(std::memory_order_acquire))
+        return nullptr;
+
+    push(&stub);
+
+    next = cur->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return cur;
+    }
+
+    return nullptr;
+}
+
+bool AlertsCommandQueue::post(Command* command)
+{
+    if (command->queued.exchange(true, std::memory_order_acq_rel))
+        return false;
+
+    push(command);
+
+    /* wake up the owner only once per drain */
+    if (!signaled.exchange(true, std::memory_order_acq_rel) && event_fd >= 0) {
+        uint64_t ev = 1;
+
+        if (write(event_fd, &ev, sizeof(ev)) != sizeof(ev))
+            nugu_error("write failed");
+    }
+
+    return true;
+}
+
+size_t AlertsCommandQueue::drain()
+{
+    uint64_t ev;
+    size_t count = 0;
+
+    /* the posts from now on wake up the owner again */
+    signaled.store(false, std::memory_order_release);
+    if (event_fd >= 0 && read(event_fd, &ev, sizeof(ev)) < 0 && errno != EAGAIN)
+        nugu_error("read failed");
+
+    while (Command* command = pop()) {
+        /* the command can be posted again from its own function */
+        command->queued.store(false, std::memory_order_release);
+
+        if (command->func)
+            command->func(command->userdata);
+
+        count++;
+    }
+
+    return count;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_COMMAND_QUEUE_H__
+#define __ALERTS_COMMAND_QUEUE_H__
+
+#include <stddef.h>
+
+#include <atomic>
+
+/**
+ * Lock-free multi-producer single-consumer command queue
+ *  - intrusive nodes (no allocation). A command is queued at most once
+ *    until it is run (post() returns false for a queued command)
+ *  - post(): any thread, one atomic exchange
+ *  - drain(): owner thread only. Runs the queued commands in order
+ *  - getFd(): eventfd to wake up the owner. Written only for the first
+ *    post after the owner started to drain.
+ */
+class AlertsCommandQueue {
+public:
+    typedef void (*CommandFunc)(void* userdata);
+
+    struct Command {
+        explicit Command(CommandFunc func = nullptr, void* userdata = nullptr);
+
+        CommandFunc func;
+        void* userdata;
+        std::atomic<Command*> next;
+        std::atomic<bool> queued;
+    };
+
+public:
+    AlertsCommandQueue();
+    virtual ~AlertsCommandQueue();
+
+    bool post(Command* command);
+    size_t drain();
+
+    int getFd() const;
+
+private:
+    void push(Command* command);
+    Command* pop();
+
+    Command stub;
+    std::atomic<Command*> head; /* producers */
+    Command* tail; /* consumer */
+    std::atomic<bool> signaled;
+    int event_fd;
+};
+
+#endif
@@ -0,0 +1,788 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_directive_parser.hh"
+
+#include <base/nugu_log.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nested objects and arrays of the directive */
+#define MAX_DEPTH 64
+
+static_assert(alerts_day_of_week("SUN", 3) == 0, "SUN");
+static_assert(alerts_day_of_week("SAT", 3) == 6, "SAT");
+static_assert(alerts_day_of_week("MONDAY", 6) == -1, "MONDAY");
+static_assert(alerts_day_of_week("MO", 2) == -1, "MO");
+
+namespace {
+
+enum ValueKind {
+    VALUE_NULL,
+    VALUE_BOOL,
+    VALUE_NUMBER,
+    VALUE_STRING,
+    VALUE_ARRAY,
+    VALUE_OBJECT
+};
+
+/* Scanned value (the string is decoded, the others are raw slices) */
+struct Value {
+    ValueKind kind;
+    const char* raw;
+    size_t raw_length;
+    size_t count; /* members or elements of the object/array */
+    bool boolean;
+};
+
+class Scanner {
+public:
+    Scanner(const char* data, size_t length)
+        : cur(data)
+        , end(data + length)
+        , depth(0)
+    {
+    }
+
+    /**
+     * Call func(key, key_length) for each member of the object. The
+     * function must consume the value (read*() or skip()).
+     */
+    template <typename Func>
+    bool object(Func func, size_t* count = nullptr)
+    {
+        size_t members = 0;
+
+        if (!consume('{') || !enter())
+            return false;
+
+        if (consume('}'))
+            return leave(count, members);
+
+        do {
+            const char* key;
+            size_t key_length;
+
+            if (!peek('"') || !name(&key, &key_length) || !consume(':'))
+                return false;
+
+            if (!func(key, key_length))
+                return false;
+
+            members++;
+        } while (consume(','));
+
+        if (!consume('}'))
+            return false;
+
+        return leave(count, members);
+    }
+
+    /* Call func() for each element of the array */
+    template <typename Func>
+    bool array(Func func, size_t* count = nullptr)
+    {
+        size_t elements = 0;
+
+        if (!consume('[') || !enter())
+            return false;
+
+        if (consume(']'))
+            return leave(count, elements);
+
+        do {
+            if (!func())
+                return false;
+
+            elements++;
+        } while (consume(','));
+
+        if (!consume(']'))
+            return false;
+
+        return leave(count, elements);
+    }
+
+    /* any value (the string is decoded to text) */
+    bool value(Value* result, std::string* text = nullptr)
+    {
+        space();
+
+        result->raw = cur;
+        result->count = 0;
+        result->boolean = false;
+
+        if (cur >= end)
+            return false;
+
+        switch (*cur) {
+        case '{':
+            result->kind = VALUE_OBJECT;
+            if (!object([&](const char*, size_t) { return skip(); }, &result->count))
+                return false;
+            break;
+        case '[':
+            result->kind = VALUE_ARRAY;
+            if (!array([&] { return skip(); }, &result->count))
+                return false;
+            break;
+        case '"':
+            result->kind = VALUE_STRING;
+            if (!string(text))
+                return false;
+            break;
+        case 't':
+            result->kind = VALUE_BOOL;
+            result->boolean = true;
+            if (!literal("true"))
+                return false;
+            break;
+        case 'f':
+            result->kind = VALUE_BOOL;
+            if (!literal("false"))
+                return false;
+            break;
+        case 'n':
+            result->kind = VALUE_NULL;
+            if (!literal("null"))
+                return false;
+            break;
+        default:
+            result->kind = VALUE_NUMBER;
+            if (!number())
+                return false;
+            break;
+        }
+
+        result->raw_length = cur - result->raw;
+
+        return true;
+    }
+
+    bool skip()
+    {
+        Value result;
+
+        return value(&result);
+    }
+
+    /* Json::Value::asString() (empty for null, object and array) */
+    bool readString(std::string* text)
+    {
+        Value result;
+
+        text->clear();
+        if (!value(&result, text))
+            return false;
+
+        if (result.kind == VALUE_BOOL || result.kind == VALUE_NUMBER)
+            text->assign(result.raw, result.raw_length);
+
+        return true;
+    }
+
+    /* Json::Value::asBool() */
+    bool readBool(bool* boolean, bool* not_null = nullptr)
+    {
+        Value result;
+
+        if (!value(&result))
+            return false;
+
+        int64_t number;
+
+        /* out of the int64 range: not zero */
+        if (result.kind == VALUE_NUMBER)
+            *boolean = !toNumber(result, &number) || number != 0;
+        else
+            *boolean = result.boolean;
+
+        if (not_null)
+            *not_null = isNotEmpty(result);
+
+        return true;
+    }
+
+    /* Json::Value::asInt() (truncated). The directive is rejected when out of the range */
+    bool readNumber(int64_t* number, bool* not_null = nullptr)
+    {
+        Value result;
+
+        if (!value(&result))
+            return false;
+
+        if (result.kind == VALUE_NUMBER) {
+            if (!toNumber(result, number)) {
+                nugu_warn("number is out of range: %.*s", (int)result.raw_length, result.raw);
+                return false;
+            }
+        } else {
+            *number = result.boolean ? 1 : 0;
+        }
+
+        if (not_null)
+            *not_null = isNotEmpty(result);
+
+        return true;
+    }
+
+    /* raw slice of the value and !Json::Value::empty() */
+    bool readRaw(const char** raw, size_t* raw_length, bool* not_empty)
+    {
+        Value result;
+
+        if (!value(&result))
+            return false;
+
+        *raw = result.raw;
+        *raw_length = result.raw_length;
+        *not_empty = isNotEmpty(result);
+
+        return true;
+    }
+
+    /* only white spaces after the value */
+    bool finish()
+    {
+        space();
+
+        return cur == end || *cur == '\0';
+    }
+
+    bool peek(char ch)
+    {
+        space();
+
+        return cur < end && *cur == ch;
+    }
+
+private:
+    static bool isNotEmpty(const Value& result)
+    {
+        if (result.kind == VALUE_NULL)
+            return false;
+
+        if (result.kind == VALUE_OBJECT || result.kind == VALUE_ARRAY)
+            return result.count > 0;
+
+        return true;
+    }
+
+    /* false if out of the int64 range (the cast of the double is undefined) */
+    static bool toNumber(const Value& result, int64_t* number)
+    {
+        char buf[64];
+
+        if (result.raw_length >= sizeof(buf)) {
+            *number = 0;
+            return true;
+        }
+
+        memcpy(buf, result.raw, result.raw_length);
+        buf[result.raw_length] = '\0';
+
+        if (strpbrk(buf, ".eE")) {
+            double real = strtod(buf, NULL);
+
+            /* [-2^63, 2^63) */
+            if (!(real >= (double)INT64_MIN && real < -(double)INT64_MIN))
+                return false;
+
+            *number = (int64_t)real;
+            return true;
+        }
+
+        errno = 0;
+        long long integer = strtoll(buf, NULL, 10);
+        if (errno == ERANGE)
+            return false;
+
+        *number = integer;
+        return true;
+    }
+
+    void space()
+    {
+        while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r'))
+            cur++;
+    }
+
+    bool consume(char ch)
+    {
+        if (!peek(ch))
+            return false;
+
+        cur++;
+        return true;
+    }
+
+    bool enter()
+    {
+        return ++depth <= MAX_DEPTH;
+    }
+
+    bool leave(size_t* count, size_t value)
+    {
+        depth--;
+        if (count)
+            *count = value;
+
+        return true;
+    }
+
+    bool literal(const char* text)
+    {
+        size_t length = strlen(text);
+
+        if ((size_t)(end - cur) < length || memcmp(cur, text, length) != 0)
+            return false;
+
+        cur += length;
+        return true;
+    }
+
+    bool digits()
+    {
+        const char* start = cur;
+
+        while (cur < end && *cur >= '0' && *cur <= '9')
+            cur++;
+
+        return cur > start;
+    }
+
+    bool number()
+    {
+        if (cur < end && *cur == '-')
+            cur++;
+
+        if (!digits())
+            return false;
+
+        if (cur < end && *cur == '.') {
+            cur++;
+            if (!digits())
+                return false;
+        }
+
+        if (cur < end && (*cur == 'e' || *cur == 'E')) {
+            cur++;
+            if (cur < end && (*cur == '+' || *cur == '-'))
+                cur++;
+            if (!digits())
+                return false;
+        }
+
+        return true;
+    }
+
+    bool hex4(unsigned int* code)
+    {
+        *code = 0;
+
+        if (end - cur < 4)
+            return false;
+
+        for (int i = 0; i < 4; i++, cur++) {
+            char ch = *cur;
+
+            *code <<= 4;
+            if (ch >= '0' && ch <= '9')
+                *code |= ch - '0';
+            else if (ch >= 'a' && ch <= 'f')
+                *code |= ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F')
+                *code |= ch - 'A' + 10;
+            else
+                return false;
+        }
+
+        return true;
+    }
+
+    static void utf8(std::string* text, unsigned int code)
+    {
+        if (code < 0x80) {
+            text->push_back((char)code);
+        } else if (code < 0x800) {
+            text->push_back((char)(0xC0 | (code >> 6)));
+            text->push_back((char)(0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            text->push_back((char)(0xE0 | (code >> 12)));
+            text->push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            text->push_back((char)(0x80 | (code & 0x3F)));
+        } else {
+            text->push_back((char)(0xF0 | (code >> 18)));
+            text->push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+            text->push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+            text->push_back((char)(0x80 | (code & 0x3F)));
+        }
+    }
+
+    bool escape(std::string* text)
+    {
+        unsigned int code;
+        char ch;
+
+        if (cur >= end)
+            return false;
+
+        ch = *cur++;
+        switch (ch) {
+        case '"':
+        case '\\':
+        case '/':
+            break;
+        case 'b':
+            ch = '\b';
+            break;
+        case 'f':
+            ch = '\f';
+            break;
+        case 'n':
+            ch = '\n';
+            break;
+        case 'r':
+            ch = '\r';
+            break;
+        case 't':
+            ch = '\t';
+            break;
+        case 'u':
+            if (!hex4(&code))
+                return false;
+
+            /* surrogate pair */
+            if (code >= 0xD800 && code <= 0xDBFF) {
+                unsigned int low;
+
+                if (!literal("\\u") || !hex4(&low) || low < 0xDC00 || low > 0xDFFF)
+                    return false;
+
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            }
+
+            if (text)
+                utf8(text, code);
+            return true;
+        default:
+            return false;
+        }
+
+        if (text)
+            text->push_back(ch);
+
+        return true;
+    }
+
+    /* member name (slice of the message if there is no escape) */
+    bool name(const char** key, size_t* key_length)
+    {
+        const char* start = cur + 1;
+        const char* pos = start;
+
+        while (pos < end && *pos != '"' && *pos != '\\' && (unsigned char)*pos >= 0x20)
+            pos++;
+
+        if (pos < end && *pos == '"') {
+            *key = start;
+            *key_length = pos - start;
+            cur = pos + 1;
+            return true;
+        }
+
+        scratch.clear();
+        if (!string(&scratch))
+            return false;
+
+        *key = scratch.data();
+        *key_length = scratch.size();
+
+        return true;
+    }
+
+    /* decoded to text (nullptr: validate only) */
+    bool string(std::string* text)
+    {
+        if (!consume('"'))
+            return false;
+
+        while (cur < end) {
+            const char* start = cur;
+
+            /* copy the plain characters at once */
+            while (cur < end && *cur != '"' && *cur != '\\' && (unsigned char)*cur >= 0x20)
+                cur++;
+
+            if (text)
+                text->append(start, cur - start);
+
+            if (cur >= end || (unsigned char)*cur < 0x20)
+                return false;
+
+            if (*cur++ == '"')
+                return true;
+
+            if (!escape(text))
+                return false;
+        }
+
+        return false;
+    }
+
+    const char* cur;
+    const char* end;
+    int depth;
+    std::string scratch;
+};
+
+} // namespace
+
+#define KEY_IS(key, length, name) \
+    ((length) == sizeof(name) - 1 && memcmp((key), (name), sizeof(name) - 1) == 0)
+
+static bool parse_repeat(Scanner& scanner, AlertsSetAlertDirective* directive)
+{
+    std::string type;
+    uint8_t days = 0;
+    size_t count = 0;
+    bool has_days = false;
+    bool valid = true;
+
+    directive->is_repeat = true;
+
+    if (!scanner.peek('{'))
+        return scanner.skip();
+
+    bool ret = scanner.object([&](const char* key, size_t length) {
+        if (KEY_IS(key, length, "type"))
+            return scanner.readString(&type);
+
+        if (!KEY_IS(key, length, "daysOfWeek") || !scanner.peek('['))
+            return scanner.skip();
+
+        has_days = true;
+        days = 0;
+
+        return scanner.array([&] {
+            std::string name;
+
+            if (!scanner.readString(&name))
+                return false;
+
+            int wday = alerts_day_of_week(name.data(), name.size());
+            if (wday < 0) {
+                nugu_error("unknown day: %s", name.c_str());
+                valid = false;
+            } else {
+                days |= 1 << wday;
+            }
+
+            return true;
+        },
+            &count);
+    });
+
+    if (!ret || !valid)
+        return false;
+
+    directive->repeat_type = type;
+
+    if (type == "DAILY") {
+        directive->wday_bitset = 0x7F;
+        directive->wday_count = 7;
+    } else if (has_days) {
+        directive->wday_bitset = days;
+        directive->wday_count = count;
+    }
+
+    return true;
+}
+
+bool AlertsDirectiveParser::parseSetAlert(const char* message, size_t length, AlertsSetAlertDirective* directive)
+{
+    Scanner scanner(message, length);
+    bool not_empty;
+
+    directive->raw = message;
+    directive->raw_length = length;
+    directive->ps_id.clear();
+    directive->token.clear();
+    directive->type.clear();
+    directive->scheduled_time.clear();
+    directive->rsrc_type.clear();
+    directive->has_activation = false;
+    directive->activation = false;
+    directive->has_assets = false;
+    directive->is_repeat = false;
+    directive->repeat_type.clear();
+    directive->wday_bitset = 0;
+    directive->wday_count = 0;
+    directive->has_asset_required = false;
+    directive->asset_required_msec = 0;
+    directive->has_min_duration = false;
+    directive->min_duration_sec = 0;
+    directive->playstack_control = nullptr;
+    directive->playstack_control_length = 0;
+
+    bool ret = scanner.object([&](const char* key, size_t key_length) {
+        if (KEY_IS(key, key_length, "playServiceId"))
+            return scanner.readString(&directive->ps_id);
+        else if (KEY_IS(key, key_length, "token"))
+            return scanner.readString(&directive->token);
+        else if (KEY_IS(key, key_length, "alertType"))
+            return scanner.readString(&directive->type);
+        else if (KEY_IS(key, key_length, "scheduledTime"))
+            return scanner.readString(&directive->scheduled_time);
+        else if (KEY_IS(key, key_length, "alarmResourceType"))
+            return scanner.readString(&directive->rsrc_type);
+        else if (KEY_IS(key, key_length, "activation"))
+            return scanner.readBool(&directive->activation, &directive->has_activation);
+        else if (KEY_IS(key, key_length, "assets")) {
+            const char* raw;
+            size_t raw_length;
+
+            return scanner.readRaw(&raw, &raw_length, &directive->has_assets);
+        } else if (KEY_IS(key, key_length, "repeat"))
+            return parse_repeat(scanner, directive);
+        else if (KEY_IS(key, key_length, "assetRequiredInMilliseconds")) {
+            directive->has_asset_required = true;
+            return scanner.readNumber(&directive->asset_required_msec);
+        } else if (KEY_IS(key, key_length, "minDurationInSec")) {
+            directive->has_min_duration = true;
+            return scanner.readNumber(&directive->min_duration_sec);
+        } else if (KEY_IS(key, key_length, "playStackControl"))
+            return scanner.readRaw(&directive->playstack_control, &directive->playstack_control_length, &not_empty);
+
+        return scanner.skip();
+    });
+
+    return ret && scanner.finish();
+}
+
+bool AlertsDirectiveParser::parseDeleteAlerts(const char* message, size_t length, AlertsDeleteAlertsDirective* directive)
+{
+    Scanner scanner(message, length);
+
+    directive->ps_id.clear();
+    directive->tokens.clear();
+
+    bool ret = scanner.object([&](const char* key, size_t key_length) {
+        if (KEY_IS(key, key_length, "playServiceId"))
+            return scanner.readString(&directive->ps_id);
+
+        if (!KEY_IS(key, key_length, "tokens") || !scanner.peek('['))
+            return scanner.skip();
+
+        directive->tokens.clear();
+
+        return scanner.array([&] {
+            directive->tokens.push_back(std::string());
+            return scanner.readString(&directive->tokens.back());
+        });
+    });
+
+    return ret && scanner.finish();
+}
+
+bool AlertsDirectiveParser::parseSetSnooze(const char* message, size_t length, AlertsSetSnoozeDirective* directive)
+{
+    Scanner scanner(message, length);
+
+    directive->ps_id.clear();
+    directive->token.clear();
+    directive->has_duration = false;
+    directive->duration_sec = 0;
+
+    bool ret = scanner.object([&](const char* key, size_t key_length) {
+        if (KEY_IS(key, key_length, "playServiceId"))
+            return scanner.readString(&directive->ps_id);
+        else if (KEY_IS(key, key_length, "token"))
+            return scanner.readString(&directive->token);
+        else if (KEY_IS(key, key_length, "durationInSec"))
+            return scanner.readNumber(&directive->duration_sec, &directive->has_duration);
+
+        return scanner.skip();
+    });
+
+    return ret && scanner.finish();
+}
+
+static bool parse_asset_detail(Scanner& scanner, AlertsAssetDetail* detail)
+{
+    detail->has_header = false;
+    detail->has_payload = false;
+    detail->payload = nullptr;
+    detail->payload_length = 0;
+
+    if (!scanner.peek('{'))
+        return scanner.skip();
+
+    return scanner.object([&](const char* key, size_t length) {
+        if (KEY_IS(key, length, "payload"))
+            return scanner.readRaw(&detail->payload, &detail->payload_length, &detail->has_payload);
+
+        if (!KEY_IS(key, length, "header") || !scanner.peek('{'))
+            return scanner.skip();
+
+        size_t count = 0;
+        bool ret = scanner.object([&](const char* hkey, size_t hlength) {
+            if (KEY_IS(hkey, hlength, "namespace"))
+                return scanner.readString(&detail->name_space);
+            else if (KEY_IS(hkey, hlength, "name"))
+                return scanner.readString(&detail->name);
+            else if (KEY_IS(hkey, hlength, "dialogRequestId"))
+                return scanner.readString(&detail->dialog_request_id);
+
+            return scanner.skip();
+        },
+            &count);
+
+        detail->has_header = count > 0;
+
+        return ret;
+    });
+}
+
+bool AlertsDirectiveParser::parseDeliveryAlertAsset(const char* message, size_t length, AlertsDeliveryAlertAssetDirective* directive)
+{
+    Scanner scanner(message, length);
+
+    directive->ps_id.clear();
+    directive->token.clear();
+    directive->asset_details.clear();
+
+    bool ret = scanner.object([&](const char* key, size_t key_length) {
+        if (KEY_IS(key, key_length, "playServiceId"))
+            return scanner.readString(&directive->ps_id);
+        else if (KEY_IS(key, key_length, "token"))
+            return scanner.readString(&directive->token);
+
+        if (!KEY_IS(key, key_length, "assetDetails") || !scanner.peek('['))
+            return scanner.skip();
+
+        directive->asset_details.clear();
+
+        return scanner.array([&] {
+            directive->asset_details.push_back(AlertsAssetDetail());
+            return parse_asset_detail(scanner, &directive->asset_details.back());
+        });
+    });
+
+    return ret && scanner.finish();
+}
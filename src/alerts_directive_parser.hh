@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_DIRECTIVE_PARSER_H__
+#define __ALERTS_DIRECTIVE_PARSER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/* name to value table (looked up at compile time or run time) */
+typedef struct _AlertsName {
+    const char* name;
+    int value;
+} AlertsName;
+
+static constexpr bool alerts_name_equal(const char* name, size_t length, const char* key)
+{
+    return length == 0 ? *key == '\0'
+                       : (*key != '\0' && *name == *key && alerts_name_equal(name + 1, length - 1, key + 1));
+}
+
+/* value of the name in the table (-1 if not found) */
+static constexpr int alerts_name_lookup(const AlertsName* table, size_t count, const char* name, size_t length)
+{
+    return count == 0 ? -1
+                      : (alerts_name_equal(name, length, table->name) ? table->value
+                                                                     : alerts_name_lookup(table + 1, count - 1, name, length));
+}
+
+/* daysOfWeek to the day of week (tm_wday: SUN = 0 ~ SAT = 6) */
+static constexpr AlertsName ALERTS_DAY_NAMES[] = {
+    { "SUN", 0 },
+    { "MON", 1 },
+    { "TUE", 2 },
+    { "WED", 3 },
+    { "THU", 4 },
+    { "FRI", 5 },
+    { "SAT", 6 },
+};
+
+static constexpr int alerts_day_of_week(const char* name, size_t length)
+{
+    return alerts_name_lookup(ALERTS_DAY_NAMES, sizeof(ALERTS_DAY_NAMES) / sizeof(ALERTS_DAY_NAMES[0]), name, length);
+}
+
+/* Fields of the SetAlert directive (or the alert JSON) */
+typedef struct _AlertsSetAlertDirective {
+    const char* raw; /* the message itself (not copied) */
+    size_t raw_length;
+
+    std::string ps_id;
+    std::string token;
+    std::string type;
+    std::string scheduled_time;
+    std::string rsrc_type;
+    bool has_activation; /* not null */
+    bool activation;
+    bool has_assets; /* not null and not empty */
+
+    bool is_repeat; /* "repeat" exists */
+    std::string repeat_type; /* "repeat.type" (e.g. DAILY, WEEKLY) */
+    uint8_t wday_bitset; /* 1 << tm_wday of daysOfWeek (all days for DAILY) */
+    uint8_t wday_count; /* number of daysOfWeek (7 for DAILY) */
+
+    bool has_asset_required;
+    int64_t asset_required_msec;
+    bool has_min_duration;
+    int64_t min_duration_sec;
+
+    const char* playstack_control; /* raw object (nullptr if not exist) */
+    size_t playstack_control_length;
+} AlertsSetAlertDirective;
+
+typedef struct _AlertsDeleteAlertsDirective {
+    std::string ps_id;
+    std::vector<std::string> tokens;
+} AlertsDeleteAlertsDirective;
+
+typedef struct _AlertsSetSnoozeDirective {
+    std::string ps_id;
+    std::string token;
+    bool has_duration; /* not null */
+    int64_t duration_sec;
+} AlertsSetSnoozeDirective;
+
+typedef struct _AlertsAssetDetail {
+    std::string name_space;
+    std::string name;
+    std::string dialog_request_id;
+    bool has_header; /* not null and not empty */
+    bool has_payload; /* not null and not empty */
+    const char* payload; /* raw object (not copied) */
+    size_t payload_length;
+} AlertsAssetDetail;
+
+typedef struct _AlertsDeliveryAlertAssetDirective {
+    std::string ps_id;
+    std::string token;
+    std::vector<AlertsAssetDetail> asset_details;
+} AlertsDeliveryAlertAssetDirective;
+
+/**
+ * Streaming parser of the Alerts directives
+ *  - extracts the fields in one pass without building a Json::Value
+ *  - the other members are validated and skipped (nested objects are
+ *    kept as the raw slices of the message)
+ *  - the missing fields are empty (same as Json::Value::asString(), ...)
+ *  - false if the message is not a valid JSON object or has an unknown
+ *    day name in daysOfWeek
+ */
+class AlertsDirectiveParser {
+public:
+    static bool parseSetAlert(const char* message, size_t length, AlertsSetAlertDirective* directive);
+    static bool parseDeleteAlerts(const char* message, size_t length, AlertsDeleteAlertsDirective* directive);
+    static bool parseSetSnooze(const char* message, size_t length, AlertsSetSnoozeDirective* directive);
+    static bool parseDeliveryAlertAsset(const char* message, size_t length, AlertsDeliveryAlertAssetDirective* directive);
+};
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_journal.hh"
+
+#include <base/nugu_log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+/* length(4) + crc32(4) */
+#define RECORD_HEADER_SIZE 8
+
+/* op(1) + seq(8) + value(8) + token length(4) */
+#define RECORD_PAYLOAD_MIN 21
+
+static bool write_all(int fd, const void* data, size_t length)
+{
+    const uint8_t* pos = (const uint8_t*)data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, pos, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        pos += written;
+        length -= written;
+    }
+
+    return true;
+}
+
+static bool read_file(const std::string& path, std::string& contents)
+{
+    struct stat st;
+    char buf[4096];
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    contents.clear();
+    if (fstat(fd, &st) == 0)
+        contents.reserve(st.st_size);
+
+    while (true) {
+        ssize_t nread = read(fd, buf, sizeof(buf));
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            break;
+
+        contents.append(buf, nread);
+    }
+
+    ::close(fd);
+
+    return true;
+}
+
+AlertsJournal::AlertsJournal()
+    : fd(-1)
+    , count(0)
+    , bytes(0)
+    , running(false)
+    , flush_requested(false)
+    , full(false)
+    , compacting(false)
+    , appended_seq(0)
+    , synced_seq(0)
+    , snapshot(nullptr)
+{
+}
+
+AlertsJournal::~AlertsJournal()
+{
+    close();
+}
+
+size_t AlertsJournal::replayFile(const std::string& path, uint64_t snapshot_seq, ReplayFunc func)
+{
+    std::string contents;
+    size_t offset = 0;
+    size_t replayed = 0;
+
+    if (!read_file(path, contents))
+        return 0;
+
+    while (offset + RECORD_HEADER_SIZE <= contents.size()) {
+        const char* record = contents.data() + offset;
+        uint32_t length;
+        uint32_t checksum;
+
+        memcpy(&length, record, sizeof(length));
+        memcpy(&checksum, record + 4, sizeof(checksum));
+
+        if (length < RECORD_PAYLOAD_MIN || length > contents.size() - offset - RECORD_HEADER_SIZE)
+            break;
+
+        const char* payload = record + RECORD_HEADER_SIZE;
+        if (AlertsSnapshot::crc32(payload, length) != checksum)
+            break;
+
+        Entry entry;
+        uint32_t token_length;
+
+        entry.op = (Op)(uint8_t)payload[0];
+        memcpy(&entry.seq, payload + 1, sizeof(entry.seq));
+        memcpy(&entry.value, payload + 9, sizeof(entry.value));
+        memcpy(&token_length, payload + 17, sizeof(token_length));
+
+        if (token_length > length - RECORD_PAYLOAD_MIN)
+            break;
+
+        entry.token.assign(payload + RECORD_PAYLOAD_MIN, token_length);
+        entry.data.assign(payload + RECORD_PAYLOAD_MIN + token_length, length - RECORD_PAYLOAD_MIN - token_length);
+        offset += RECORD_HEADER_SIZE + length;
+
+        /* already in the snapshot */
+        if (entry.seq <= snapshot_seq)
+            continue;
+
+        if (func)
+            func(entry);
+
+        replayed++;
+    }
+
+    if (offset != contents.size())
+        nugu_warn("drop the broken journal tail (%zd bytes)", contents.size() - offset);
+
+    return replayed;
+}
+
+size_t AlertsJournal::replay(const std::string& path, uint64_t snapshot_seq, ReplayFunc func)
+{
+    size_t replayed = replayFile(path + ".old", snapshot_seq, func);
+
+    replayed += replayFile(path, snapshot_seq, func);
+
+    nugu_info("journal replayed: %zd entries (%s)", replayed, path.c_str());
+
+    return replayed;
+}
+
+bool AlertsJournal::openFile()
+{
+    fd = ::open(journal_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        nugu_error("open(%s) failed", journal_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool AlertsJournal::open(const std::string& path, uint64_t last_seq)
+{
+    if (running)
+        return false;
+
+    journal_path = path;
+    appended_seq = last_seq;
+    synced_seq = last_seq;
+
+    if (!openFile())
+        return false;
+
+    if (!AlertsSnapshot::syncDirectory(journal_path))
+        nugu_warn("fsync of the directory (%s) failed", journal_path.c_str());
+
+    struct stat st;
+
+    count = replayFile(journal_path, 0, nullptr);
+    bytes = (fstat(fd, &st) == 0) ? st.st_size : 0;
+    checkRotated();
+    running = true;
+    writer_thread = std::thread([this] { run(); });
+
+    return true;
+}
+
+void AlertsJournal::close()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!running)
+            return;
+
+        running = false;
+        cond.notify_all();
+    }
+
+    writer_thread.join();
+
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool AlertsJournal::isOpened()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return running;
+}
+
+void AlertsJournal::append(Op op, const std::string& token, const std::string& data, int64_t value)
+{
+    std::string record(RECORD_HEADER_SIZE + RECORD_PAYLOAD_MIN, '\0');
+    uint32_t token_length = token.size();
+
+    record[RECORD_HEADER_SIZE] = (char)op;
+    memcpy(&record[RECORD_HEADER_SIZE + 9], &value, sizeof(value));
+    memcpy(&record[RECORD_HEADER_SIZE + 17], &token_length, sizeof(token_length));
+    record.append(token);
+    record.append(data);
+
+    uint32_t length = record.size() - RECORD_HEADER_SIZE;
+    memcpy(&record[0], &length, sizeof(length));
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (!running)
+        return;
+
+    /* kept by the snapshot of the caller (needCompaction). The records
+     * during the compaction are kept for the snapshot being saved */
+    if (full && !compacting)
+        return;
+
+    uint64_t seq = appended_seq + 1;
+    memcpy(&record[RECORD_HEADER_SIZE + 1], &seq, sizeof(seq));
+
+    uint32_t checksum = AlertsSnapshot::crc32(record.data() + RECORD_HEADER_SIZE, length);
+    memcpy(&record[4], &checksum, sizeof(checksum));
+
+    buffer.append(record);
+    appended_seq = seq;
+    count++;
+    bytes += record.size();
+    cond.notify_all();
+}
+
+void AlertsJournal::sync()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    uint64_t target = appended_seq;
+
+    while (running && (synced_seq < target || compacting)) {
+        flush_requested = true;
+        cond.notify_all();
+        synced_cond.wait(guard);
+    }
+}
+
+uint64_t AlertsJournal::getSeq()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return appended_seq;
+}
+
+bool AlertsJournal::needCompaction()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return running && snapshot == nullptr
+        && (full || count >= JOURNAL_COMPACTION_THRESHOLD || bytes >= JOURNAL_COMPACTION_BYTES);
+}
+
+void AlertsJournal::compact(AlertsSnapshotWriter* writer, const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!running || snapshot != nullptr) {
+        delete writer;
+        return;
+    }
+
+    nugu_info("journal compaction (%zd entries)", count);
+
+    /* the records before the snapshot go to the rotated journal */
+    rotate_buffer.swap(buffer);
+    buffer.clear();
+    writer->setJournalSeq(appended_seq);
+    snapshot = writer;
+    snapshot_path = path;
+    compacting = true;
+    count = 0;
+    bytes = 0;
+    cond.notify_all();
+}
+
+/* Refuse the appends while the rotated journal is over the limit (lock held) */
+void AlertsJournal::checkRotated()
+{
+    struct stat st;
+    bool over = stat((journal_path + ".old").c_str(), &st) == 0
+        && (size_t)st.st_size >= JOURNAL_ROTATED_LIMIT_BYTES;
+
+    if (over && !full)
+        nugu_error("rotated journal is over %d bytes (snapshot failed). refuse the appends", JOURNAL_ROTATED_LIMIT_BYTES);
+    else if (!over && full)
+        nugu_info("rotated journal is compacted. accept the appends");
+
+    full = over;
+}
+
+/* Move the current journal to <path>.old (writer thread) */
+void AlertsJournal::rotate(const std::string& records)
+{
+    std::string old_path = journal_path + ".old";
+
+    if (!records.empty() && !write_all(fd, records.data(), records.size()))
+        nugu_error("journal write failed");
+
+    if (access(old_path.c_str(), F_OK) == 0) {
+        /* previous compaction was not finished. keep all the records */
+        std::string contents;
+        int old_fd = ::open(old_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+
+        if (old_fd >= 0 && read_file(journal_path, contents)
+            && write_all(old_fd, contents.data(), contents.size())
+            && fdatasync(old_fd) == 0) {
+            if (ftruncate(fd, 0) < 0)
+                nugu_error("ftruncate failed");
+        } else {
+            nugu_error("journal rotation failed");
+        }
+
+        if (old_fd >= 0)
+            ::close(old_fd);
+
+        return;
+    }
+
+    fdatasync(fd);
+    ::close(fd);
+
+    if (rename(journal_path.c_str(), old_path.c_str()) < 0)
+        nugu_error("rename(%s) failed", old_path.c_str());
+
+    /* the rename and the new journal are durable with the directory */
+    if (openFile() && !AlertsSnapshot::syncDirectory(journal_path))
+        nugu_error("fsync of the directory (%s) failed", journal_path.c_str());
+}
+
+void AlertsJournal::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    while (true) {
+        while (running && buffer.empty() && snapshot == nullptr)
+            cond.wait(guard);
+
+        if (!running && buffer.empty() && snapshot == nullptr)
+            break;
+
+        /* group commit: gather the records for a while */
+        cond.wait_for(guard, std::chrono::milliseconds(JOURNAL_COMMIT_INTERVAL_MSEC), [this] {
+            return !running || flush_requested || snapshot != nullptr;
+        });
+
+        std::string records;
+        std::string rotated;
+        AlertsSnapshotWriter* writer = snapshot;
+        std::string path = snapshot_path;
+        uint64_t seq = appended_seq;
+
+        records.swap(buffer);
+        rotated.swap(rotate_buffer);
+        snapshot = nullptr;
+        flush_requested = false;
+
+        guard.unlock();
+
+        if (writer)
+            rotate(rotated);
+
+        if (fd >= 0 && !records.empty()) {
+            if (!write_all(fd, records.data(), records.size()))
+                nugu_error("journal write failed");
+        }
+
+        if (fd >= 0)
+            fdatasync(fd);
+
+        if (writer) {
+            if (writer->save(path))
+                unlink((journal_path + ".old").c_str());
+
+            delete writer;
+        }
+
+        guard.lock();
+
+        if (writer) {
+            checkRotated();
+            compacting = (snapshot != nullptr);
+        }
+
+        synced_seq = seq;
+        synced_cond.notify_all();
+    }
+
+    synced_cond.notify_all();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_JOURNAL_H__
+#define __ALERTS_JOURNAL_H__
+
+#include "alerts_snapshot.hh"
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define JOURNAL_COMMIT_INTERVAL_MSEC 50
+#define JOURNAL_COMPACTION_THRESHOLD 128
+
+/* compaction by the size */
+#define JOURNAL_COMPACTION_BYTES (1024 * 1024)
+
+/**
+ * The rotated journal grows while the snapshot can't be saved. Over this
+ * size the new records are refused (the next snapshot has them) to keep
+ * the replay bounded, instead of dropping the durable records.
+ */
+#define JOURNAL_ROTATED_LIMIT_BYTES (JOURNAL_COMPACTION_BYTES * 4)
+
+/**
+ * Write-ahead journal of the alert mutations
+ *  - <path>: current journal, <path>.old: rotated journal (compaction)
+ *  - record: length(4) | crc32(4) | op(1) | seq(8) | value(8)
+ *            | token length(4) | token | data
+ *  - seq increases over the restarts (open). The snapshot keeps the seq of
+ *    its last record, and the replay skips the records at or below it
+ *  - append() is buffered. The writer thread flushes all the records
+ *    gathered during JOURNAL_COMMIT_INTERVAL_MSEC with one fdatasync().
+ *  - compact() rotates the journal and saves the snapshot in the writer
+ *    thread. A torn record at the tail is dropped on replay.
+ *  - the replay is bounded by the compaction: all the valid records are
+ *    replayed, and the appends are refused while the rotated journal is
+ *    over JOURNAL_ROTATED_LIMIT_BYTES. Each refused change is kept by the
+ *    snapshot requested right after it (needCompaction)
+ */
+class AlertsJournal {
+public:
+    enum Op {
+        OP_ADD = 1, /* data: original json */
+        OP_REMOVE,
+        OP_ACTIVATE,
+        OP_DEACTIVATE,
+        OP_SNOOZE, /* value: snooze deadline (epoch secs) */
+        OP_RESET
+    };
+
+    struct Entry {
+        Op op;
+        uint64_t seq;
+        int64_t value;
+        std::string token;
+        std::string data;
+    };
+
+    typedef std::function<void(const Entry& entry)> ReplayFunc;
+
+public:
+    AlertsJournal();
+    virtual ~AlertsJournal();
+
+    /**
+     * Replay <path>.old and <path> in order, except the records at or below
+     * snapshot_seq. Returns the replayed count
+     */
+    static size_t replay(const std::string& path, uint64_t snapshot_seq, ReplayFunc func);
+
+    /* last_seq: the last seq of the snapshot and the replayed records */
+    bool open(const std::string& path, uint64_t last_seq = 0);
+    void close();
+    bool isOpened();
+
+    void append(Op op, const std::string& token, const std::string& data = "", int64_t value = 0);
+
+    /* wait until all the appended records (and the snapshot) are durable */
+    void sync();
+
+    /* seq of the last appended record */
+    uint64_t getSeq();
+
+    bool needCompaction();
+    void compact(AlertsSnapshotWriter* writer, const std::string& snapshot_path);
+
+private:
+    static size_t replayFile(const std::string& path, uint64_t snapshot_seq, ReplayFunc func);
+    bool openFile();
+    void run();
+    void rotate(const std::string& records);
+    void checkRotated();
+
+    std::string journal_path;
+    int fd;
+    size_t count;
+    size_t bytes;
+
+    std::thread writer_thread;
+    std::mutex lock;
+    std::condition_variable cond;
+    std::condition_variable synced_cond;
+    bool running;
+    bool flush_requested;
+    bool full; /* the rotated journal is over the limit */
+    bool compacting; /* until the requested snapshot is saved (or failed) */
+    std::string buffer;
+    uint64_t appended_seq;
+    uint64_t synced_seq;
+
+    /* compaction request */
+    AlertsSnapshotWriter* snapshot;
+    std::string snapshot_path;
+    std::string rotate_buffer;
+};
+
+#endif
@@ -15,42 +15,360 @@
  */
 
 #include "alerts_manager.hh"
+#include "alerts_time_parser.hh"
 
 #include <base/nugu_log.h>
 #include <string.h>
-#include <sys/eventfd.h>
 #include <unistd.h>
 
-#include <thread>
-
 #ifndef G_SOURCE_FUNC
 #define G_SOURCE_FUNC(f) ((GSourceFunc)(void (*)(void))(f))
 #endif
 
+/**
+ * Armed timer record (pooled)
+ *  - token: only for the timers without an alert item (handle == 0).
+ *    Otherwise, the token of the item is used. (no string copy)
+ */
 struct timeout_data {
     AlertsManager* manager;
     std::string token;
-    AlertItem* item;
+    AlertHandle handle;
+    int64_t deadline_msec;
+
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
 };
 
-static void dump_time_t(const char* prefix, time_t timestamp)
+static void dump_time_t(const AlertsTimezone& zone, const char* prefix, time_t timestamp)
 {
-    struct tm local_tm;
-    struct tm gmt_tm;
+    AlertsLocalTime local_tm;
+    AlertsLocalTime gmt_tm;
 
-    localtime_r(&timestamp, &local_tm);
-    gmtime_r(&timestamp, &gmt_tm);
+    zone.breakDown(timestamp, &local_tm);
+    AlertsTimezone().breakDown(timestamp, &gmt_tm);
 
     nugu_dbg(" %s(LOCAL) %04d-%02d-%02d %02d:%02d:%02d (%d)", prefix,
-        local_tm.tm_year, local_tm.tm_mon, local_tm.tm_mday,
-        local_tm.tm_hour, local_tm.tm_min, local_tm.tm_sec, timestamp);
+        local_tm.year, local_tm.month, local_tm.day,
+        local_tm.hour, local_tm.minute, local_tm.second, timestamp);
     nugu_dbg(" %s( GMT ) %04d-%02d-%02d %02d:%02d:%02d (%d)", prefix,
-        gmt_tm.tm_year, gmt_tm.tm_mon, gmt_tm.tm_mday, gmt_tm.tm_hour,
-        gmt_tm.tm_min, gmt_tm.tm_sec, timestamp);
+        gmt_tm.year, gmt_tm.month, gmt_tm.day, gmt_tm.hour,
+        gmt_tm.minute, gmt_tm.second, timestamp);
+}
+
+/* days from wday to the nearest day of the bitset (7: no day) */
+struct NextDayTable {
+    uint8_t value[DAY_ALL + 1][7];
+
+    NextDayTable()
+    {
+        for (int bitset = 0; bitset <= DAY_ALL; bitset++) {
+            for (int wday = 0; wday < 7; wday++) {
+                int k = 0;
+
+                while (k < 7 && (bitset & (1 << ((wday + k) % 7))) == 0)
+                    k++;
+
+                value[bitset][wday] = k;
+            }
+        }
+    }
+};
+
+/* Hot records of all the managers are packed in the shared block */
+static AlertsPool<AlertItem>& item_pool(void)
+{
+    /* never destroyed: items may be released after the static destructors */
+    static AlertsPool<AlertItem>* pool = new AlertsPool<AlertItem>(MAX_ALERTS);
+
+    return *pool;
+}
+
+static AlertsPool<timeout_data>& timeout_pool(void)
+{
+    static AlertsPool<timeout_data>* pool = new AlertsPool<timeout_data>(MAX_ALERT_TIMERS);
+
+    return *pool;
+}
+
+void* _AlertItem::operator new(size_t size)
+{
+    return item_pool().allocate();
+}
+
+void _AlertItem::operator delete(void* ptr)
+{
+    item_pool().release(ptr);
+}
+
+void* timeout_data::operator new(size_t size)
+{
+    return timeout_pool().allocate();
+}
+
+void timeout_data::operator delete(void* ptr)
+{
+    timeout_pool().release(ptr);
+}
+
+static constexpr AlertsName ALERT_TYPE_NAMES[] = {
+    { "TIMER", ALERT_TYPE_TIMER },
+    { "ALARM", ALERT_TYPE_ALARM },
+    { "SLEEP", ALERT_TYPE_SLEEP },
+    { "ACTION", ALERT_TYPE_ACTION },
+};
+
+static constexpr AlertsName ALERT_RESOURCE_NAMES[] = {
+    { "INTERNAL", ALERT_RESOURCE_INTERNAL },
+    { "MUSIC", ALERT_RESOURCE_MUSIC },
+    { "TTS", ALERT_RESOURCE_TTS },
+};
+
+/* daysOfWeek bits of the directive parser (1 << tm_wday) */
+static_assert(DAY_SUN == 1 << 0 && DAY_SAT == 1 << 6 && DAY_ALL == 0x7F, "day bits");
+static_assert(alerts_name_lookup(ALERT_TYPE_NAMES, 4, "ACTION", 6) == ALERT_TYPE_ACTION, "alert type");
+
+/* unknown type is TIMER */
+static enum alert_type parse_alert_type(const std::string& type_str)
+{
+    int value = alerts_name_lookup(ALERT_TYPE_NAMES, sizeof(ALERT_TYPE_NAMES) / sizeof(ALERT_TYPE_NAMES[0]),
+        type_str.data(), type_str.size());
+
+    return value < 0 ? ALERT_TYPE_TIMER : (enum alert_type)value;
+}
+
+static enum alert_resource parse_alert_resource(const std::string& rsrc_type)
+{
+    int value = alerts_name_lookup(ALERT_RESOURCE_NAMES, sizeof(ALERT_RESOURCE_NAMES) / sizeof(ALERT_RESOURCE_NAMES[0]),
+        rsrc_type.data(), rsrc_type.size());
+
+    return value < 0 ? ALERT_RESOURCE_UNKNOWN : (enum alert_resource)value;
+}
+
+/**
+ * Parse the original JSON on the first use (e.g. restored from snapshot).
+ * The activation changed after the JSON was written (json_dirty) is
+ * applied here, not by activate()/deactivate().
+ */
+static Json::Value& item_json(AlertItem* item)
+{
+    if (!item->payload->json_loaded) {
+        Json::Reader reader;
+
+        if (!reader.parse(item->payload->json_str, item->payload->json))
+            nugu_error("invalid json (%s)", item->token.c_str());
+
+        item->payload->json_loaded = true;
+    }
+
+    if (item->payload->json_dirty)
+        item->payload->json["activation"] = item->payload->activation;
+
+    return item->payload->json;
+}
+
+/* Fields of the alert required by the context (without parsing the JSON) */
+static void project_alert(AlertItem* item, Json::Value& alert)
+{
+    const size_t day_count = sizeof(ALERTS_DAY_NAMES) / sizeof(ALERTS_DAY_NAMES[0]);
+
+    /* optional fields only when present (as the directive) */
+    if (!item->payload->ps_id.empty())
+        alert["playServiceId"] = item->payload->ps_id;
+
+    alert["token"] = item->token;
+    alert["alertType"] = item->payload->type_str;
+    alert["scheduledTime"] = item->payload->scheduled_time;
+    alert["activation"] = item->payload->activation;
+
+    if (!item->payload->rsrc_type.empty())
+        alert["alarmResourceType"] = item->payload->rsrc_type;
+
+    if (!item->is_repeat)
+        return;
+
+    /* the repeat type of the directive (WEEKLY of all days is not DAILY) */
+    alert["repeat"] = Json::Value(Json::objectValue);
+    if (!item->payload->repeat_type.empty())
+        alert["repeat"]["type"] = item->payload->repeat_type;
+
+    if (item->payload->repeat_type == "DAILY")
+        return;
+
+    /* MON ~ SUN */
+    for (size_t i = 1; i <= day_count; i++) {
+        const AlertsName& day = ALERTS_DAY_NAMES[i % day_count];
+
+        if (item->wday_bitset & (1 << day.value))
+            alert["repeat"]["daysOfWeek"].append(day.name);
+    }
+}
+
+/* Serialize the modified JSON on the first read */
+static const std::string& item_json_str(AlertItem* item)
+{
+    if (item->payload->json_dirty) {
+        Json::FastWriter writer;
+
+        item->payload->json_str = writer.write(item_json(item));
+        item->payload->json_dirty = false;
+    }
+
+    return item->payload->json_str;
+}
+
+AlertsManager::AlertsManager(AlertsClock* cclock)
+    : listener(nullptr)
+    , clock(cclock ? cclock : new AlertsSystemClock())
+    , clock_owned(cclock == nullptr)
+    , dispatch_command(dispatch_command_func, this)
+    , clock_command(clock_command_func, this)
+    , armed_tick(0)
+    , anchor_realtime(clock->realtimeMsec())
+    , anchor_monotonic(clock->monotonicMsec())
+    , wheel(anchor_realtime / TIMER_TICK_MSEC)
+    , precision_mode(false)
+    , zone(AlertsTimezone::local())
+    , max_alarms(MAX_ALARM)
+    , max_alerts(MAX_ALERTS)
+    , journal(nullptr)
+    , version(1)
+{
+    memset(&fire_stats, 0, sizeof(fire_stats));
+    memset(&local_day, 0, sizeof(local_day));
+    memset(&last_creation, 0, sizeof(last_creation));
+    memset(type_counts, 0, sizeof(type_counts));
+    memset(single_items, 0, sizeof(single_items));
+
+    wheel.reserve(MAX_ALERT_TIMERS);
+    dispatching.reserve(MAX_ALERT_TIMERS);
+
+    /* creation and pending (or changed) index of each item */
+    alerts_reserve_nodes(MAX_ALERTS * 2);
+
+    /* commands from the timer thread (and the other threads) */
+    owner_ctx = g_main_context_ref_thread_default();
+    command_src = 0;
+    if (commands.getFd() >= 0) {
+        GIOChannel* channel = g_io_channel_unix_new(commands.getFd());
+        GSource* source = g_io_create_watch(channel, G_IO_IN);
+
+        g_source_set_callback(source, G_SOURCE_FUNC(command_fd_callback), this, NULL);
+        command_src = g_source_attach(source, owner_ctx);
+        g_source_unref(source);
+        g_io_channel_unref(channel);
+    }
+
+    clock->setListener(this);
+}
+
+AlertsManager::~AlertsManager()
+{
+    /* The clock change handler touches the items. Wait for the callback. */
+    clock->setListener(nullptr);
+
+    if (clock_owned)
+        delete clock;
+
+    timer_lock.lock();
+    wheel.clear();
+    timer_lock.unlock();
+
+    /* the queued commands are dropped */
+    if (command_src) {
+        GSource* source = g_main_context_find_source_by_id(owner_ctx, command_src);
+        if (source)
+            g_source_destroy(source);
+    }
+    g_main_context_unref(owner_ctx);
+
+    /* flush the pending journal records */
+    if (journal)
+        delete journal;
+
+    for (auto const& item : creation_index) {
+        nugu_dbg("delete %s", item->token.c_str());
+        delete item;
+    }
+
+    creation_index.clear();
+    token_index.clear();
+}
+
+void AlertsManager::setListener(IAlertsManagerListener* clistener)
+{
+    listener = clistener;
+}
+
+bool AlertsManager::post(AlertsCommandQueue::Command* command)
+{
+    return commands.post(command);
+}
+
+void AlertsManager::setPrecisionMode(bool enable)
+{
+    std::vector<AlertItem*> rearm_list;
+
+    if (precision_mode == enable)
+        return;
+
+    nugu_info("precision mode: %d", enable);
+
+    precision_mode = enable;
+
+    /* Re-arm the alarm deadlines with the new resolution (keep snooze) */
+    for (auto const& iter : fire_index) {
+        AlertItem* item = iter.second;
+        if (item->timer_src != 0 && item->snooze_secs == 0)
+            rearm_list.push_back(item);
+    }
+
+    if (rearm_list.empty())
+        return;
+
+    for (auto const& item : rearm_list)
+        done(item);
+
+    scheduling();
+}
+
+bool AlertsManager::isPrecisionMode()
+{
+    return precision_mode;
+}
+
+/* Local H:M:S of today + k to UTC (DST of the target day) */
+static time_t local_day_to_utc(const AlertsTimezone& zone, const AlertsLocalDay& day, int k, time_t hms)
+{
+    if (day.midnight[k + 1] - day.midnight[k] == 86400)
+        return day.midnight[k] + hms;
+
+    return zone.toUtc((day.days + k) * 86400 + hms);
+}
+
+/* Local midnights from today (recomputed when the day is changed) */
+const AlertsLocalDay& AlertsManager::localDay(time_t now)
+{
+    if (now >= local_day.midnight[0] && now < local_day.midnight[1])
+        return local_day;
+
+    time_t local = zone.toLocal(now);
+
+    local_day.days = local / 86400 - (local % 86400 < 0 ? 1 : 0);
+    local_day.wday = AlertsTimezone::weekday(local_day.days);
+
+    for (int i = 0; i <= LOCAL_DAY_CACHE; i++)
+        local_day.midnight[i] = zone.toUtc((local_day.days + i) * 86400);
+
+    nugu_dbg("local day %" G_GINT64_FORMAT " (wday %d)", local_day.days, local_day.wday);
+
+    return local_day;
 }
 
-static void calculate_timeout(time_t now, AlertItem* item)
+void AlertsManager::calculateTimeout(time_t now, AlertItem* item)
 {
+    static const NextDayTable table;
+
     nugu_dbg(" - available days: 0x%X", item->wday_bitset);
 
     if (item->is_repeat == false) {
@@ -58,394 +376,1122 @@ static void calculate_timeout(time_t now, AlertItem* item)
         return;
     }
 
-    struct tm now_tm;
-    localtime_r(&now, &now_tm);
+    const AlertsLocalDay& day = localDay(now);
+    uint8_t bitset = item->wday_bitset & DAY_ALL;
+    time_t now_local_hms;
 
-    time_t now_local_hms = (now_tm.tm_hour * 3600) + (now_tm.tm_min * 60) + now_tm.tm_sec;
+    /* 24 hours day: the local time is the offset from the midnight */
+    if (day.midnight[1] - day.midnight[0] == 86400)
+        now_local_hms = now - day.midnight[0];
+    else
+        now_local_hms = zone.toLocal(now) - day.days * 86400;
 
     /* Find the nearest day of the week from today. */
-    int min_day = 7;
-    for (int i = 0, bit = 1; i <= 7; i++, bit = bit << 1) {
-        if ((item->wday_bitset & bit) != bit)
-            continue;
+    int min_day = table.value[bitset][day.wday];
 
-        /* Find the nearest day of the week. */
-        int k = (i + 7 - now_tm.tm_wday) % 7;
+    /* Matches today, but time has passed. (from tomorrow) */
+    if (min_day == 0 && item->hms_local_secs < now_local_hms)
+        min_day = 1 + table.value[bitset][(day.wday + 1) % 7];
 
-        /* Matches today, but time has passed. (set to next week) */
-        if (k == 0 && item->hms_local_secs < now_local_hms)
-            k = 7;
+    item->timeout_secs = local_day_to_utc(zone, day, min_day, item->hms_local_secs) - now;
 
-        if (k < min_day)
-            min_day = k;
+    /* The repeated time of today (DST overlap) has passed. (from tomorrow) */
+    if (min_day == 0 && item->timeout_secs < 0) {
+        min_day = 1 + table.value[bitset][(day.wday + 1) % 7];
+        item->timeout_secs = local_day_to_utc(zone, day, min_day, item->hms_local_secs) - now;
     }
 
     nugu_dbg(" - candidate day: today + %d", min_day);
-    int target_local_hms = item->hms_local_secs + (min_day * 86400);
+}
+
+/* calculateTimeout() with the fractional seconds (precision mode) */
+int64_t AlertsManager::calculateTimeoutMsec(int64_t now_msec, AlertItem* item)
+{
+    time_t now = now_msec / 1000;
+    int64_t timeout_msec;
 
-    /* Get today time data using Y-M-D (without H:M:S) */
-    struct tm time_data;
-    memset(&time_data, 0, sizeof(struct tm));
-    time_data.tm_year = now_tm.tm_year;
-    time_data.tm_mon = now_tm.tm_mon;
-    time_data.tm_mday = now_tm.tm_mday;
+    calculateTimeout(now, item);
+    timeout_msec = (int64_t)item->timeout_secs * 1000 + item->frac_msec - now_msec % 1000;
 
-    /* Add H:M:S information to Y-M-D timestamp */
-    item->timeout_secs = mktime(&time_data) + target_local_hms - now;
+    /* Matches this second, but the msec has passed. (set to next) */
+    if (timeout_msec < 0 && item->is_repeat) {
+        calculateTimeout(now + 1, item);
+        item->timeout_secs += 1;
+        timeout_msec = (int64_t)item->timeout_secs * 1000 + item->frac_msec - now_msec % 1000;
+    }
+
+    return timeout_msec;
 }
 
-AlertsManager::AlertsManager()
-    : listener(nullptr)
+bool AlertsManager::setCapacity(size_t cmax_alarms, size_t cmax_alerts)
 {
-    quit_fd = eventfd(0, EFD_CLOEXEC);
-    loop_ctx = g_main_context_new();
-
-    day_map = {
-        { "MON", DAY_MON },
-        { "TUE", DAY_TUE },
-        { "WED", DAY_WED },
-        { "THU", DAY_THU },
-        { "FRI", DAY_FRI },
-        { "SAT", DAY_SAT },
-        { "SUN", DAY_SUN },
-    };
+    if (cmax_alarms < 1 || cmax_alarms > cmax_alerts || cmax_alerts > MAX_ALERTS_LIMIT) {
+        nugu_error("invalid capacity (alarms: %zu, alerts: %zu)", cmax_alarms, cmax_alerts);
+        return false;
+    }
 
-    std::thread t([&] {
-        GMainLoop* loop;
-        GIOChannel* channel;
-        GSource* source;
+    max_alarms = cmax_alarms;
+    max_alerts = cmax_alerts;
 
-        loop = g_main_loop_new(loop_ctx, FALSE);
+    /* no heap overflow up to the capacity */
+    item_pool().reserve(max_alerts);
+    timeout_pool().reserve(max_alerts * ALERT_TIMERS_PER_ALERT);
+    alerts_reserve_nodes(max_alerts * 2);
 
-        /* Create event-fd IO watch */
-        channel = g_io_channel_unix_new(quit_fd);
-        source = g_io_create_watch(channel, G_IO_IN);
-        g_source_set_callback(source, G_SOURCE_FUNC(quit_fd_callback), loop, NULL);
-        g_source_attach(source, loop_ctx);
-        g_source_unref(source);
-        g_io_channel_unref(channel);
+    timer_lock.lock();
+    wheel.reserve(max_alerts * ALERT_TIMERS_PER_ALERT);
+    dispatching.reserve(max_alerts * ALERT_TIMERS_PER_ALERT);
+    timer_lock.unlock();
 
-        nugu_info("start loop");
-        g_main_loop_run(loop);
-        g_main_loop_unref(loop);
-        nugu_info("exit loop");
-    });
+    nugu_info("capacity: %zu alarms, %zu alerts", max_alarms, max_alerts);
 
-    int ret = pthread_setname_np(t.native_handle(), "alarm_timer");
-    if (ret < 0)
-        nugu_error("pthread_setname_np failed");
+    return true;
+}
 
-    t.detach();
+size_t AlertsManager::getMaxAlarmCount()
+{
+    return max_alarms;
 }
 
-AlertsManager::~AlertsManager()
+size_t AlertsManager::getMaxAlertCount()
 {
-    uint64_t ev = 1;
+    return max_alerts;
+}
 
-    int written = write(quit_fd, &ev, sizeof(ev));
-    if (written != sizeof(ev)) {
-        nugu_error("write failed");
-    }
+bool AlertsManager::setTimezone(const std::string& name)
+{
+    std::vector<AlertItem*> rearm_list;
 
-    for (auto const& iter : token_map) {
-        nugu_dbg("delete %s", iter.first.c_str());
+    if (!zone.load(name) && !zone.loadRule(name))
+        return false;
+
+    nugu_info("timezone: %s", zone.getName().c_str());
+
+    /* recompute the local day */
+    memset(&local_day, 0, sizeof(local_day));
+
+    /* Repeat alarms follow the local time of the new timezone (keep snooze) */
+    for (auto const& iter : fire_index) {
         AlertItem* item = iter.second;
-        delete item;
+        if (item->timer_src != 0 && item->snooze_secs == 0 && item->is_repeat)
+            rearm_list.push_back(item);
     }
 
-    token_map.clear();
+    if (rearm_list.empty())
+        return true;
+
+    for (auto const& item : rearm_list)
+        done(item);
+
+    scheduling();
+
+    return true;
 }
 
-void AlertsManager::setListener(IAlertsManagerListener* clistener)
+const AlertsTimezone& AlertsManager::getTimezone()
 {
-    listener = clistener;
+    return zone;
 }
 
-/* callback in thread context */
-gboolean AlertsManager::quit_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata)
+AlertsFireStats AlertsManager::getFireStats()
 {
-    nugu_info("quit alert GMainLoop!");
-    g_main_loop_quit((GMainLoop*)userdata);
-    return FALSE;
+    std::lock_guard<std::mutex> lock(timer_lock);
+
+    return fire_stats;
 }
 
-/* callback in thread context */
-gboolean AlertsManager::timeout_callback(gpointer userdata)
+void AlertsManager::resetFireStats()
 {
-    struct timeout_data* td = (struct timeout_data*)userdata;
+    std::lock_guard<std::mutex> lock(timer_lock);
 
-    if (td->item)
-        td->item->timer_src = 0;
+    memset(&fire_stats, 0, sizeof(fire_stats));
+}
 
-    if (td->manager->listener)
-        td->manager->listener->onTimeout(td->token);
+AlertsPoolStats AlertsManager::getItemPoolStats()
+{
+    return item_pool().getStats();
+}
+
+AlertsPoolStats AlertsManager::getTimeoutPoolStats()
+{
+    return timeout_pool().getStats();
+}
+
+/* callback in the owner context */
+void AlertsManager::recordFireOffset(int64_t offset)
+{
+    std::lock_guard<std::mutex> lock(timer_lock);
+
+    if (fire_stats.count == 0 || offset < fire_stats.min)
+        fire_stats.min = offset;
+    if (fire_stats.count == 0 || offset > fire_stats.max)
+        fire_stats.max = offset;
+
+    fire_stats.last = offset;
+    fire_stats.sum += offset;
+    fire_stats.count++;
+}
+
+/* callback in the clock context */
+void AlertsManager::onClockTimer()
+{
+    /* the owner collects the due timers and re-arms the clock */
+    commands.post(&dispatch_command);
+
+    /* virtual clock: already in the owner context */
+    if (clock->isSynchronous())
+        commands.drain();
+}
+
+/* callback in the clock context */
+void AlertsManager::onClockChanged()
+{
+    commands.post(&clock_command);
+
+    if (clock->isSynchronous())
+        commands.drain();
+}
+
+/* callback in the owner context */
+gboolean AlertsManager::command_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata)
+{
+    AlertsManager* manager = (AlertsManager*)userdata;
+
+    manager->commands.drain();
+
+    return TRUE;
+}
 
-    return FALSE;
+void AlertsManager::dispatch_command_func(void* userdata)
+{
+    ((AlertsManager*)userdata)->dispatchTimeout();
+}
+
+void AlertsManager::clock_command_func(void* userdata)
+{
+    ((AlertsManager*)userdata)->handleClockChange();
 }
 
-/* callback in thread context */
-gboolean AlertsManager::asset_timeout_callback(gpointer userdata)
+/* nullptr if the item is removed after the timer is armed */
+static AlertItem* timeout_item(struct timeout_data* td)
+{
+    if (td->handle == 0)
+        return nullptr;
+
+    AlertItem* item = td->manager->getItem(td->handle);
+    if (!item)
+        nugu_dbg("drop the timer of the removed item");
+
+    return item;
+}
+
+/* valid until the listener removes the item */
+static const std::string& timeout_token(struct timeout_data* td, AlertItem* item)
+{
+    return item ? item->token : td->token;
+}
+
+/* callback in the owner context */
+void AlertsManager::timeout_callback(void* userdata)
 {
     struct timeout_data* td = (struct timeout_data*)userdata;
+    int64_t offset = (int64_t)td->manager->clock->realtimeMsec() - td->deadline_msec;
 
-    if (td->item)
-        td->item->asset_timer_src = 0;
+    td->manager->recordFireOffset(offset);
 
-    if (td->manager->listener)
-        td->manager->listener->onAssetRequireTimeout(td->token);
+    AlertItem* item = timeout_item(td);
+    if (td->handle != 0 && !item)
+        return;
+
+    nugu_dbg("fire offset %" G_GINT64_FORMAT " msec (%s)", offset, timeout_token(td, item).c_str());
+
+    if (item) {
+        item->timer_src = 0;
+        item->fired_msec = td->deadline_msec;
+    }
 
-    return FALSE;
+    if (td->manager->listener)
+        td->manager->listener->onTimeout(timeout_token(td, item));
 }
 
-/* callback in thread context */
-gboolean AlertsManager::duration_timeout_callback(gpointer userdata)
+/* callback in the owner context */
+void AlertsManager::asset_timeout_callback(void* userdata)
 {
     struct timeout_data* td = (struct timeout_data*)userdata;
 
-    if (td->item)
-        td->item->duration_timer_src = 0;
+    AlertItem* item = timeout_item(td);
+    if (td->handle != 0 && !item)
+        return;
+
+    if (item)
+        item->asset_timer_src = 0;
 
     if (td->manager->listener)
-        td->manager->listener->onDurationTimeout(td->token);
+        td->manager->listener->onAssetRequireTimeout(timeout_token(td, item));
+}
+
+/* callback in the owner context */
+void AlertsManager::duration_timeout_callback(void* userdata)
+{
+    struct timeout_data* td = (struct timeout_data*)userdata;
 
-    return FALSE;
+    AlertItem* item = timeout_item(td);
+    if (td->handle != 0 && !item)
+        return;
+
+    if (item)
+        item->duration_timer_src = 0;
+
+    if (td->manager->listener)
+        td->manager->listener->onDurationTimeout(timeout_token(td, item));
 }
 
-static void _timeout_destroy_notify(gpointer userdata)
+static void _timeout_destroy_notify(void* userdata)
 {
     struct timeout_data* td = (struct timeout_data*)userdata;
 
     delete td;
 }
 
-guint AlertsManager::addTimeout(time_t secs, const std::string& token)
+/* Arm the clock to the nearest due slot (timer_lock must be held) */
+void AlertsManager::rearmTimer()
 {
-    struct timeout_data* td;
+    uint64_t tick;
 
-    td = new timeout_data;
-    td->manager = this;
-    td->token = token;
-    td->item = findItem(token);
+    if (!wheel.nextExpiry(&tick)) {
+        if (armed_tick != 0) {
+            armed_tick = 0;
+            clock->arm(0);
+        }
+        return;
+    }
 
-    GSource* source = g_timeout_source_new_seconds(secs);
-    if (!source) {
-        delete td;
+    if (tick == armed_tick)
+        return;
+
+    armed_tick = tick;
+
+    /* zero value disarms the timer */
+    clock->arm(tick ? tick * TIMER_TICK_MSEC : 1);
+}
+
+/**
+ * Compare the realtime clock with the monotonic clock since the last anchor
+ * and move the wheel by the difference. Absolute (wall-clock) deadlines stay
+ * as they are and relative deadlines are shifted with the clock.
+ * Returns the clock offset in msec. (timer_lock must be held)
+ */
+int64_t AlertsManager::reanchor()
+{
+    uint64_t rt = clock->realtimeMsec();
+    uint64_t mono = clock->monotonicMsec();
+    int64_t offset = (int64_t)(rt - anchor_realtime) - (int64_t)(mono - anchor_monotonic);
+
+    anchor_realtime = rt;
+    anchor_monotonic = mono;
+
+    if (offset > -CLOCK_DRIFT_MSEC && offset < CLOCK_DRIFT_MSEC) {
+        /* slewing only: keep the remainder for the next anchor */
+        anchor_realtime -= offset;
         return 0;
     }
 
-    g_source_set_callback(source, G_SOURCE_FUNC(timeout_callback), td, _timeout_destroy_notify);
+    nugu_info("realtime clock moved %" G_GINT64_FORMAT " msec", offset);
 
-    nugu_info("add timeout %zd secs (%s)", secs, token.c_str());
+    wheel.rebase(rt / TIMER_TICK_MSEC, offset / TIMER_TICK_MSEC);
+    armed_tick = 0;
 
-    guint src_id = g_source_attach(source, loop_ctx);
-    g_source_unref(source);
+    return offset;
+}
 
-    nugu_dbg(" - timer_src: %d", src_id);
+/* Recompute the deadlines affected by the clock offset (owner context) */
+void AlertsManager::rescheduleClockChange(int64_t offset)
+{
+    time_t now = clock->realtimeMsec() / 1000;
+    time_t delta = offset / 1000;
+    std::vector<AlertItem*> changed_list;
 
-    return src_id;
+    /**
+     * Recompute only the affected deadlines
+     *  - snooze: relative deadline. follow the clock
+     *  - alarm: wall-clock deadline. find the next occurrence again
+     *  - already passed deadlines are fired by the timing wheel
+     */
+    for (auto const& iter : fire_index) {
+        AlertItem* item = iter.second;
+
+        if (item->timer_src == 0)
+            continue;
+
+        if (item->snooze_secs) {
+            changed_list.push_back(item);
+            continue;
+        }
+
+        if (item->secs <= now)
+            continue;
+
+        /* one-shot alarm has an absolute deadline */
+        if (!item->is_repeat)
+            continue;
+
+        time_t timeout_secs = item->timeout_secs;
+        calculateTimeout(now, item);
+        bool moved = (now + item->timeout_secs != item->secs);
+        item->timeout_secs = timeout_secs;
+
+        if (moved)
+            changed_list.push_back(item);
+    }
+
+    for (auto const& item : changed_list) {
+        if (item->snooze_secs) {
+            unscheduleItem(item, true);
+            item->secs += delta;
+            item->fire_msec += offset;
+            scheduleItem(item);
+            continue;
+        }
+
+        nugu_dbg("reschedule %s", item->token.c_str());
+        done(item);
+    }
+}
+
+/* Clock change notified by the clock (owner context) */
+void AlertsManager::handleClockChange()
+{
+    /* the timezone is not reloaded here (setTimezone) */
+
+    /* the deadline was cancelled. re-anchored and armed again by the dispatch */
+    dispatchTimeout();
+    scheduling();
+}
+
+/**
+ * Fire all due timers (owner context)
+ *  - the clock step is handled by the first of the dispatch and the clock
+ *    change (e.g. a step between the fire and the re-arm of the clock is
+ *    seen by the dispatch only)
+ */
+void AlertsManager::dispatchTimeout()
+{
+    timer_lock.lock();
+    int64_t offset = reanchor();
+    timer_lock.unlock();
+
+    if (offset != 0)
+        rescheduleClockChange(offset);
+
+    timer_lock.lock();
+    dispatching.clear();
+    wheel.collect(clock->realtimeMsec() / TIMER_TICK_MSEC, dispatching);
+    armed_tick = 0;
+    rearmTimer();
+    timer_lock.unlock();
+
+    for (size_t i = 0;; i++) {
+        AlertsTimerWheel::Expired expired;
+
+        /* removeTimeout() may cancel the remaining items in the batch */
+        timer_lock.lock();
+        if (i >= dispatching.size()) {
+            dispatching.clear();
+            timer_lock.unlock();
+            break;
+        }
+        expired = dispatching[i];
+        dispatching[i].func = nullptr;
+        timer_lock.unlock();
+
+        if (expired.func)
+            expired.func(expired.userdata);
+
+        if (expired.destroy)
+            expired.destroy(expired.userdata);
+    }
+
+    /* the rescheduled alarms */
+    if (offset != 0)
+        scheduling();
 }
 
-guint AlertsManager::addAssetTimeout(time_t secs, const std::string& token)
+AlertTimerId AlertsManager::addWheelTimeout(int64_t expire_msec, const std::string& token, AlertsTimerWheel::TimerFunc func, bool relative)
 {
     struct timeout_data* td;
 
+    if (expire_msec < 0)
+        expire_msec = 0;
+
     td = new timeout_data;
     td->manager = this;
-    td->token = token;
-    td->item = findItem(token);
+    td->handle = 0;
+    AlertItem* item = findItem(token);
+    if (item)
+        td->handle = item->handle;
+    else
+        td->token = token;
+    td->deadline_msec = expire_msec;
 
-    GSource* source = g_timeout_source_new_seconds(secs);
-    if (!source) {
+    std::lock_guard<std::mutex> lock(timer_lock);
+
+    AlertTimerId src_id = wheel.add(expire_msec / TIMER_TICK_MSEC, func, td, _timeout_destroy_notify, relative);
+    if (src_id == 0) {
         delete td;
         return 0;
     }
 
-    g_source_set_callback(source, G_SOURCE_FUNC(asset_timeout_callback), td, _timeout_destroy_notify);
+    rearmTimer();
 
-    nugu_info("add asset timeout %zd secs (%s)", secs, token.c_str());
+    return src_id;
+}
+
+/* now + secs (rounded up to the whole second if not precision mode) */
+int64_t AlertsManager::relativeDeadline(time_t secs)
+{
+    int64_t expire_msec = (int64_t)clock->realtimeMsec() + (int64_t)secs * 1000;
 
-    guint src_id = g_source_attach(source, loop_ctx);
-    g_source_unref(source);
+    if (precision_mode)
+        return expire_msec;
 
-    nugu_dbg(" - asset_timer_src: %d", src_id);
+    return (expire_msec + 999) / 1000 * 1000;
+}
+
+AlertTimerId AlertsManager::addTimeout(time_t secs, const std::string& token, bool relative)
+{
+    nugu_info("add timeout %zd secs (%s)", secs, token.c_str());
+
+    if (relative)
+        return addTimeoutAt(relativeDeadline(secs), token, true);
+
+    return addTimeoutAt((int64_t)(clock->realtimeMsec() / 1000 + secs) * 1000, token);
+}
+
+AlertTimerId AlertsManager::addTimeoutAt(int64_t expire_msec, const std::string& token, bool relative)
+{
+    AlertTimerId src_id = addWheelTimeout(expire_msec, token, timeout_callback, relative);
+
+    nugu_dbg(" - timer_src: %" G_GUINT64_FORMAT " (at %" G_GINT64_FORMAT " msec)", src_id, expire_msec);
 
     return src_id;
 }
 
-guint AlertsManager::addDurationTimeout(time_t secs, const std::string& token)
+AlertTimerId AlertsManager::addAssetTimeout(time_t secs, const std::string& token)
 {
-    struct timeout_data* td;
+    nugu_info("add asset timeout %zd secs (%s)", secs, token.c_str());
 
-    td = new timeout_data;
-    td->manager = this;
-    td->token = token;
-    td->item = findItem(token);
+    AlertTimerId src_id = addWheelTimeout((int64_t)(clock->realtimeMsec() / 1000 + secs) * 1000, token, asset_timeout_callback);
 
-    GSource* source = g_timeout_source_new_seconds(secs);
-    if (!source) {
-        delete td;
-        return 0;
-    }
+    nugu_dbg(" - asset_timer_src: %" G_GUINT64_FORMAT, src_id);
 
-    g_source_set_callback(source, G_SOURCE_FUNC(duration_timeout_callback), td, _timeout_destroy_notify);
+    return src_id;
+}
 
+AlertTimerId AlertsManager::addDurationTimeout(time_t secs, const std::string& token)
+{
     nugu_info("add duration timeout %zd secs (%s)", secs, token.c_str());
 
-    guint src_id = g_source_attach(source, loop_ctx);
-    g_source_unref(source);
+    AlertTimerId src_id = addWheelTimeout(relativeDeadline(secs), token, duration_timeout_callback, true);
+
+    nugu_dbg(" - duration_timer_src: %" G_GUINT64_FORMAT, src_id);
+
+    return src_id;
+}
+
+AlertTimerId AlertsManager::addCallbackTimeout(time_t secs, AlertsTimerWheel::TimerFunc func, void* userdata)
+{
+    nugu_info("add callback timeout %zd secs", secs);
+
+    int64_t expire_msec = relativeDeadline(secs);
+    std::lock_guard<std::mutex> lock(timer_lock);
 
-    nugu_dbg(" - duration_timer_src: %d", src_id);
+    AlertTimerId src_id = wheel.add(expire_msec / TIMER_TICK_MSEC, func, userdata, nullptr, true);
+    if (src_id != 0)
+        rearmTimer();
 
     return src_id;
 }
 
-void AlertsManager::removeTimeout(guint timer_src)
+void AlertsManager::removeTimeout(AlertTimerId timer_src)
 {
     if (timer_src == 0)
         return;
 
-    nugu_info("remove timeout(GSource) %d", timer_src);
+    nugu_info("remove timeout %" G_GUINT64_FORMAT, timer_src);
 
-    GSource* source = g_main_context_find_source_by_id(loop_ctx, timer_src);
-    if (source)
-        g_source_destroy(source);
+    std::lock_guard<std::mutex> lock(timer_lock);
+
+    if (wheel.remove(timer_src)) {
+        rearmTimer();
+        return;
+    }
+
+    /* Already expired but not yet dispatched */
+    for (auto& iter : dispatching) {
+        if (iter.id == timer_src)
+            iter.func = nullptr;
+    }
 }
 
 AlertItem* AlertsManager::generateAlert(const Json::Value& json_item)
 {
     Json::FastWriter writer;
+    AlertsSetAlertDirective directive;
+    std::string json_str = writer.write(json_item);
+
+    if (!AlertsDirectiveParser::parseSetAlert(json_str.c_str(), json_str.size(), &directive)) {
+        nugu_error("invalid alert");
+        return nullptr;
+    }
+
+    AlertItem* item = generateAlert(directive);
+    if (!item)
+        return nullptr;
+
+    /* keep the parsed JSON */
+    item->payload->json = json_item;
+    item->payload->json_loaded = true;
+
+    return item;
+}
+
+AlertItem* AlertsManager::generateAlert(const AlertsSetAlertDirective& directive)
+{
     AlertItem* item;
-    struct tm time_data;
+    AlertsLocalTime time_data;
 
     item = new AlertItem();
+    item->payload.reset(new AlertItemPayload());
     item->timeout_secs = 0;
-    item->json_str = writer.write(json_item);
-    item->json = json_item;
+    item->payload->json_str.assign(directive.raw, directive.raw_length);
+    item->payload->json_loaded = false;
+    item->payload->json_dirty = false;
     item->wday_bitset = DAY_NONE;
     item->wday_count = 1;
     item->is_ignored = false;
-    item->token = json_item["token"].asString();
-    item->scheduled_time = json_item["scheduledTime"].asString();
-    item->is_activated = json_item["activation"].asBool();
-    item->is_repeat = json_item.isMember("repeat");
-    item->ps_id = json_item["playServiceId"].asString();
-    item->rsrc_type = json_item["alarmResourceType"].asString();
-    item->type_str = json_item["alertType"].asString();
-    item->has_routine = item->json_str.find("Routine.Start") != std::string::npos;
-    item->audioplayer = nullptr;
-    clock_gettime(CLOCK_REALTIME, &item->creation_time);
-
-    if (item->type_str == "ALARM")
-        item->type = ALERT_TYPE_ALARM;
-    else if (item->type_str == "TIMER")
-        item->type = ALERT_TYPE_TIMER;
-    else if (item->type_str == "SLEEP")
-        item->type = ALERT_TYPE_SLEEP;
-    else if (item->type_str == "ACTION")
-        item->type = ALERT_TYPE_ACTION;
-
-    if (json_item.isMember("assetRequiredInMilliseconds"))
-        item->asset_secs = json_item["assetRequiredInMilliseconds"].asInt() / 1000;
+    item->token = directive.token;
+    item->payload->scheduled_time = directive.scheduled_time;
+    item->is_activated = directive.activation;
+    item->payload->activation = item->is_activated;
+    item->is_repeat = directive.is_repeat;
+    item->payload->repeat_type = directive.repeat_type;
+    item->payload->ps_id = directive.ps_id;
+    item->payload->rsrc_type = directive.rsrc_type;
+    item->payload->type_str = directive.type;
+    item->type = parse_alert_type(item->payload->type_str);
+    item->rsrc = parse_alert_resource(item->payload->rsrc_type);
+    item->has_routine = item->payload->json_str.find("Routine.Start") != std::string::npos;
+    item->payload->audioplayer = nullptr;
+    clock->getTime(CLOCK_REALTIME, &item->creation_time);
+
+    /* strictly increasing (same reading of the virtual clock, ...) */
+    if (item->creation_time.tv_sec < last_creation.tv_sec
+        || (item->creation_time.tv_sec == last_creation.tv_sec
+            && item->creation_time.tv_nsec <= last_creation.tv_nsec)) {
+        item->creation_time = last_creation;
+        if (++item->creation_time.tv_nsec >= 1000000000) {
+            item->creation_time.tv_sec++;
+            item->creation_time.tv_nsec = 0;
+        }
+    }
+    last_creation = item->creation_time;
+
+    if (directive.has_asset_required)
+        item->asset_secs = directive.asset_required_msec / 1000;
     else
         item->asset_secs = 0;
 
-    if (json_item.isMember("minDurationInSec"))
-        item->duration_secs = json_item["minDurationInSec"].asInt();
+    if (directive.has_min_duration)
+        item->duration_secs = directive.min_duration_sec;
     else
         item->duration_secs = DEFAULT_ALARM_DURATION_SEC;
 
     memset(&time_data, 0, sizeof(time_data));
 
     nugu_info("New alert - %s", item->token.c_str());
-    nugu_dbg("- scheduled_time: %s", item->scheduled_time.c_str());
+    nugu_dbg("- scheduled_time: %s", item->payload->scheduled_time.c_str());
     nugu_dbg("- activation: %d / type: %s / rsrc: %s", item->is_activated,
-        item->type_str.c_str(), item->rsrc_type.c_str());
+        item->payload->type_str.c_str(), item->payload->rsrc_type.c_str());
+
+    /* Repeat alerts only have H:M:S information. (without Y-M-D) */
+    AlertsTime scheduled = alerts_parse_time(item->payload->scheduled_time.data(), item->payload->scheduled_time.size());
+    if (!scheduled.valid || scheduled.has_date == item->is_repeat) {
+        nugu_error("invalid scheduledTime: %s", item->payload->scheduled_time.c_str());
+        delete item;
+        return nullptr;
+    }
+
+    item->frac_msec = scheduled.msec;
+    time_data.hour = scheduled.hour;
+    time_data.minute = scheduled.minute;
+    time_data.second = scheduled.second;
 
     if (item->is_repeat) {
-        std::string type = json_item["repeat"]["type"].asString();
-        if (type == "DAILY") {
-            /* Everyday */
-            item->wday_bitset = DAY_ALL;
-            item->wday_count = 7;
-        } else {
-            /* List of days of the week (save to bitset) */
-            Json::Value days = json_item["repeat"]["daysOfWeek"];
-            item->wday_count = days.size();
-            for (int i = 0; i < item->wday_count; i++)
-                item->wday_bitset = item->wday_bitset | day_map.at(days[i].asString());
+        /* Everyday (DAILY) or the days of the week (bit: 1 << tm_wday) */
+        item->wday_bitset = directive.wday_bitset;
+        item->wday_count = directive.wday_count;
+    } else {
+        time_t secs = AlertsTimezone::daysFromCivil(scheduled.year, scheduled.month, scheduled.day) * 86400
+            + scheduled.hour * 3600 + scheduled.minute * 60 + scheduled.second;
+
+        /* the UTC offset of the scheduledTime if exists, otherwise the
+         * local time of the device timezone */
+        if (scheduled.has_offset)
+            item->local_secs = secs - scheduled.offset_secs;
+        else
+            item->local_secs = zone.toUtc(secs);
+        dump_time_t(zone, "- ", item->local_secs);
+
+        zone.breakDown(item->local_secs, &time_data);
+        item->wday_bitset = (1 << time_data.wday);
+    }
+
+    nugu_dbg("- Repeat days: 0x%X / count: %d", item->wday_bitset, item->wday_count);
+
+    /* Local time Hour:Min:Sec to seconds */
+    item->hms_local_secs = (time_data.hour * 3600) + (time_data.minute * 60) + time_data.second;
+
+    nugu_dbg("- (LOCAL) %02d:%02d:%02d (%d)", time_data.hour,
+        time_data.minute, time_data.second, item->hms_local_secs);
+
+    return item;
+}
+
+AlertItem* AlertsManager::generateAlert(const AlertsSnapshot& snapshot, size_t index)
+{
+    const AlertsSnapshotRecord* record = snapshot.getRecord(index);
+    AlertItem* item;
+
+    if (!record)
+        return nullptr;
+
+    /* CRC-valid record of the other version */
+    if (record->type >= ALERT_TYPE_COUNT) {
+        nugu_error("invalid alert type %d", record->type);
+        return nullptr;
+    }
+
+    item = new AlertItem();
+    item->payload.reset(new AlertItemPayload());
+    item->token = snapshot.getString(record, SNAPSHOT_FIELD_TOKEN);
+    item->payload->json_str = snapshot.getString(record, SNAPSHOT_FIELD_JSON);
+    item->payload->json_loaded = false;
+    item->payload->json_dirty = false;
+    item->payload->scheduled_time = snapshot.getString(record, SNAPSHOT_FIELD_SCHEDULED_TIME);
+    item->payload->ps_id = snapshot.getString(record, SNAPSHOT_FIELD_PS_ID);
+    item->payload->rsrc_type = snapshot.getString(record, SNAPSHOT_FIELD_RSRC_TYPE);
+    item->payload->type_str = snapshot.getString(record, SNAPSHOT_FIELD_TYPE_STR);
+    item->payload->repeat_type = snapshot.getString(record, SNAPSHOT_FIELD_REPEAT_TYPE);
+    item->type = (enum alert_type)record->type;
+    item->rsrc = parse_alert_resource(item->payload->rsrc_type);
+    item->is_activated = (record->flags & SNAPSHOT_FLAG_ACTIVATED) != 0;
+    item->payload->activation = item->is_activated;
+    item->is_repeat = (record->flags & SNAPSHOT_FLAG_REPEAT) != 0;
+    item->has_routine = (record->flags & SNAPSHOT_FLAG_ROUTINE) != 0;
+    item->wday_bitset = record->wday_bitset;
+    item->wday_count = record->wday_count;
+    item->hms_local_secs = record->hms_local_secs;
+    item->local_secs = record->local_secs;
+    item->frac_msec = record->frac_msec;
+    item->asset_secs = record->asset_secs;
+    item->duration_secs = record->duration_secs;
+    item->creation_time.tv_sec = record->creation_sec;
+    item->creation_time.tv_nsec = record->creation_nsec;
+    item->payload->audioplayer = nullptr;
+
+    return item;
+}
+
+void AlertsManager::buildSnapshot(AlertsSnapshotWriter& writer)
+{
+    time_t now = clock->realtimeMsec() / 1000;
+
+    /* creation order: the restored items keep the same ignore priority */
+    for (auto const& item : creation_index) {
+        AlertsSnapshotRecord record;
+        std::string strings[SNAPSHOT_FIELD_MAX];
+
+        memset(&record, 0, sizeof(record));
+        record.local_secs = item->local_secs;
+        record.creation_sec = item->creation_time.tv_sec;
+        record.creation_nsec = item->creation_time.tv_nsec;
+        record.hms_local_secs = item->hms_local_secs;
+        record.asset_secs = item->asset_secs;
+        record.duration_secs = item->duration_secs;
+        record.frac_msec = item->frac_msec;
+        record.type = item->type;
+        record.wday_bitset = item->wday_bitset;
+        record.wday_count = item->wday_count;
+
+        /* absolute deadline of the snooze (same as OP_SNOOZE) */
+        if (item->snooze_secs)
+            record.snooze_deadline = item->timer_src ? item->fire_msec / 1000 : now + item->snooze_secs;
+
+        /* activation of the directive (not changed by snooze) */
+        if (item->payload->activation)
+            record.flags |= SNAPSHOT_FLAG_ACTIVATED;
+        if (item->is_repeat)
+            record.flags |= SNAPSHOT_FLAG_REPEAT;
+        if (item->has_routine)
+            record.flags |= SNAPSHOT_FLAG_ROUTINE;
+
+        strings[SNAPSHOT_FIELD_TOKEN] = item->token;
+        strings[SNAPSHOT_FIELD_JSON] = item_json_str(item);
+        strings[SNAPSHOT_FIELD_SCHEDULED_TIME] = item->payload->scheduled_time;
+        strings[SNAPSHOT_FIELD_PS_ID] = item->payload->ps_id;
+        strings[SNAPSHOT_FIELD_RSRC_TYPE] = item->payload->rsrc_type;
+        strings[SNAPSHOT_FIELD_TYPE_STR] = item->payload->type_str;
+        strings[SNAPSHOT_FIELD_REPEAT_TYPE] = item->payload->repeat_type;
+
+        writer.append(record, strings);
+    }
+}
+
+bool AlertsManager::saveSnapshot(const std::string& path)
+{
+    AlertsSnapshotWriter writer;
+
+    buildSnapshot(writer);
+
+    /* the journal records so far are in the snapshot of the journal */
+    if (journal && path == snapshot_path)
+        writer.setJournalSeq(journal->getSeq());
+
+    return writer.save(path);
+}
+
+bool AlertsManager::loadSnapshot(const std::string& path, uint64_t* journal_seq)
+{
+    AlertsSnapshot snapshot;
+
+    if (!snapshot.open(path))
+        return false;
+
+    if (journal_seq)
+        *journal_seq = snapshot.getJournalSeq();
+
+    time_t now = clock->realtimeMsec() / 1000;
+
+    /* The snapshot was consistent when saved. Skip processDuplication. */
+    for (size_t i = 0; i < snapshot.count(); i++) {
+        AlertItem* item = generateAlert(snapshot, i);
+        if (!item)
+            continue;
+
+        if (addItem(item) == false) {
+            delete item;
+            continue;
         }
 
-        /* Repeat alerts only have H:M:S information. (without Y-M-D) */
-        /* NOLINTNEXTLINE */
-        sscanf(item->scheduled_time.c_str(), "%d:%d:%d",
-            &time_data.tm_hour, &time_data.tm_min,
-            &time_data.tm_sec);
-    } else {
-        /* NOLINTNEXTLINE */
-        sscanf(item->scheduled_time.c_str(), "%d-%d-%dT%d:%d:%d",
-            &time_data.tm_year, &time_data.tm_mon,
-            &time_data.tm_mday, &time_data.tm_hour,
-            &time_data.tm_min, &time_data.tm_sec);
+        /* snooze deadline is absolute. skip the expired one */
+        int64_t snooze_deadline = snapshot.getRecord(i)->snooze_deadline;
+        if (snooze_deadline > now)
+            snooze(item, snooze_deadline - now);
+    }
 
-        /* year start from 1900 */
-        time_data.tm_year -= 1900;
+    scheduling();
 
-        /* month of year (0 - 11) */
-        time_data.tm_mon -= 1;
+    return true;
+}
 
-        /* set specific time
-         * Some device do not support the timelocal() API.
-         * So, the KST(+9) time is manually calculated */
-        item->local_secs = timegm(&time_data) - 9 * 3600;
-        dump_time_t("- ", item->local_secs);
+bool AlertsManager::openJournal(const std::string& path)
+{
+    std::string journal_path = path + ".journal";
 
-        localtime_r(&item->local_secs, &time_data);
-        item->wday_bitset = (1 << time_data.tm_wday);
+    if (journal) {
+        nugu_error("journal is already opened");
+        return false;
     }
 
-    nugu_dbg("- Repeat days: 0x%X / count: %d", item->wday_bitset, item->wday_count);
+    snapshot_path = path;
 
-    /* Local time Hour:Min:Sec to seconds */
-    item->hms_local_secs = (time_data.tm_hour * 3600) + (time_data.tm_min * 60) + time_data.tm_sec;
+    /* snapshot + journal records after the snapshot (bounded replay) */
+    uint64_t snapshot_seq = 0;
+    loadSnapshot(path, &snapshot_seq);
 
-    nugu_dbg("- (LOCAL) %02d:%02d:%02d (%d)", time_data.tm_hour,
-        time_data.tm_min, time_data.tm_sec, item->hms_local_secs);
+    uint64_t last_seq = snapshot_seq;
+    size_t replayed = AlertsJournal::replay(journal_path, snapshot_seq, [this, &last_seq](const AlertsJournal::Entry& entry) {
+        replayJournal(entry);
+        last_seq = entry.seq;
+    });
 
-    return item;
+    if (replayed > 0) {
+        AlertsSnapshotWriter writer;
+
+        scheduling();
+
+        /* start with an empty journal */
+        buildSnapshot(writer);
+        writer.setJournalSeq(last_seq);
+        if (writer.save(path)) {
+            unlink(journal_path.c_str());
+            unlink((journal_path + ".old").c_str());
+        }
+    }
+
+    journal = new AlertsJournal();
+    if (!journal->open(journal_path, last_seq)) {
+        delete journal;
+        journal = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void AlertsManager::syncJournal()
+{
+    if (journal)
+        journal->sync();
+}
+
+void AlertsManager::replayJournal(const AlertsJournal::Entry& entry)
+{
+    AlertItem* item = nullptr;
+    AlertsSetAlertDirective directive;
+    int64_t remain;
+
+    if (entry.op != AlertsJournal::OP_ADD && entry.op != AlertsJournal::OP_RESET) {
+        item = findItem(entry.token);
+        if (!item)
+            return;
+    }
+
+    switch (entry.op) {
+    case AlertsJournal::OP_ADD:
+        if (findItem(entry.token) != nullptr
+            || !AlertsDirectiveParser::parseSetAlert(entry.data.c_str(), entry.data.size(), &directive))
+            break;
+
+        applyAdd(generateAlert(directive));
+        break;
+    case AlertsJournal::OP_REMOVE:
+        removeItem(entry.token);
+        break;
+    case AlertsJournal::OP_ACTIVATE:
+        activate(item);
+        break;
+    case AlertsJournal::OP_DEACTIVATE:
+        deactivate(item);
+        break;
+    case AlertsJournal::OP_SNOOZE:
+        /* snooze deadline is absolute. skip the expired one */
+        remain = entry.value - (int64_t)(clock->realtimeMsec() / 1000);
+        if (remain > 0)
+            snooze(item, remain);
+        break;
+    case AlertsJournal::OP_RESET:
+        reset();
+        break;
+    default:
+        nugu_warn("unknown journal op %d", entry.op);
+        break;
+    }
 }
 
-static bool _compare_creation_time_func(AlertItem* a, AlertItem* b)
+void AlertsManager::appendJournal(AlertsJournal::Op op, const std::string& token, const std::string& data, int64_t value)
+{
+    if (!journal)
+        return;
+
+    journal->append(op, token, data, value);
+
+    if (journal->needCompaction()) {
+        AlertsSnapshotWriter* writer = new AlertsSnapshotWriter();
+
+        buildSnapshot(*writer);
+        journal->compact(writer, snapshot_path);
+    }
+}
+
+bool AlertItemCreationOrder::operator()(const AlertItem* a, const AlertItem* b) const
 {
     if (a->creation_time.tv_sec != b->creation_time.tv_sec)
         return a->creation_time.tv_sec < b->creation_time.tv_sec;
 
-    return a->creation_time.tv_nsec < b->creation_time.tv_nsec;
+    if (a->creation_time.tv_nsec != b->creation_time.tv_nsec)
+        return a->creation_time.tv_nsec < b->creation_time.tv_nsec;
+
+    return std::less<const AlertItem*>()(a, b);
+}
+
+/* (type, day of week, H:M:S) => occupancy_index key */
+static inline uint64_t occupancy_key(enum alert_type type, int wday, time_t hms)
+{
+    return ((uint64_t)type << 40) | ((uint64_t)wday << 32) | (uint32_t)hms;
+}
+
+void AlertsManager::acquireHandle(AlertItem* item)
+{
+    uint32_t index;
+
+    std::lock_guard<std::mutex> guard(slot_lock);
+
+    if (free_slots.empty()) {
+        slots.push_back(AlertSlot { nullptr, 1 });
+        index = slots.size() - 1;
+    } else {
+        index = free_slots.back();
+        free_slots.pop_back();
+    }
+
+    slots[index].item = item;
+    item->handle = ((uint64_t)slots[index].generation << 32) | (index + 1);
+}
+
+void AlertsManager::releaseHandle(AlertItem* item)
+{
+    uint32_t index = (uint32_t)(item->handle & 0xFFFFFFFF);
+
+    if (index == 0)
+        return;
+
+    std::lock_guard<std::mutex> guard(slot_lock);
+
+    /* stale handles of this slot are rejected from now on */
+    slots[index - 1].item = nullptr;
+    slots[index - 1].generation++;
+    free_slots.push_back(index - 1);
+    item->handle = 0;
+}
+
+void AlertsManager::indexItem(AlertItem* item)
+{
+    type_counts[item->type]++;
+    if (item->type != ALERT_TYPE_ALARM)
+        single_items[item->type] = item;
+
+    creation_index.insert(item);
+    pending_index.insert(item);
+    indexOccupancy(item);
+}
+
+void AlertsManager::unindexItem(AlertItem* item)
+{
+    unscheduleItem(item, true);
+
+    type_counts[item->type]--;
+    if (single_items[item->type] == item)
+        single_items[item->type] = nullptr;
+
+    creation_index.erase(item);
+    pending_index.erase(item);
+    unindexOccupancy(item);
+}
+
+void AlertsManager::indexOccupancy(AlertItem* item)
+{
+    for (int wday = 0; wday < 7; wday++) {
+        if ((item->wday_bitset & (1 << wday)) == 0)
+            continue;
+
+        occupancy_index[occupancy_key(item->type, wday, item->hms_local_secs)].push_back(item);
+    }
+}
+
+void AlertsManager::unindexOccupancy(AlertItem* item)
+{
+    for (int wday = 0; wday < 7; wday++) {
+        if ((item->wday_bitset & (1 << wday)) == 0)
+            continue;
+
+        auto iter = occupancy_index.find(occupancy_key(item->type, wday, item->hms_local_secs));
+        if (iter == occupancy_index.end())
+            continue;
+
+        std::vector<AlertItem*>& slot = iter->second;
+        for (size_t i = 0; i < slot.size(); i++) {
+            if (slot[i] == item) {
+                slot[i] = slot.back();
+                slot.pop_back();
+                break;
+            }
+        }
+
+        if (slot.empty())
+            occupancy_index.erase(iter);
+    }
+}
+
+void AlertsManager::scheduleItem(AlertItem* item)
+{
+    if (item->is_scheduled)
+        unscheduleItem(item, false);
+
+    fire_index.insert(std::make_pair(item->secs, item));
+    item->is_scheduled = true;
+
+    updateIgnored(item->secs);
+}
+
+/**
+ * cancelled: the timer is removed before firing. In this case, the items
+ * ignored by this item should get a chance to fire.
+ */
+void AlertsManager::unscheduleItem(AlertItem* item, bool cancelled)
+{
+    if (!item->is_scheduled)
+        return;
+
+    item->is_scheduled = false;
+
+    auto range = fire_index.equal_range(item->secs);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        if (iter->second == item) {
+            fire_index.erase(iter);
+            break;
+        }
+    }
+
+    if (cancelled)
+        updateIgnored(item->secs);
+}
+
+/* Among the alerts with the same fire time, only the latest one plays. */
+void AlertsManager::updateIgnored(time_t secs)
+{
+    AlertItemCreationOrder is_older;
+    AlertItem* latest = nullptr;
+
+    auto range = fire_index.equal_range(secs);
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        if (latest == nullptr || is_older(latest, iter->second))
+            latest = iter->second;
+    }
+
+    for (auto iter = range.first; iter != range.second; ++iter) {
+        AlertItem* item = iter->second;
+        bool ignored = (item != latest);
+
+        if (ignored && !item->is_ignored)
+            nugu_info("- set ignored flag to %s", item->token.c_str());
+
+        item->is_ignored = ignored;
+    }
 }
 
 void AlertsManager::scheduling(time_t base_timestamp)
 {
-    struct tm now_tm;
-
-    if (base_timestamp == 0)
-        base_timestamp = time(NULL);
-
-    localtime_r(&base_timestamp, &now_tm);
+    AlertItemSet changed_list;
+    int64_t base_msec;
 
-    nugu_info("Scheduling! base %zd", base_timestamp);
-    dump_time_t("- NOW ", base_timestamp);
-
-    std::vector<AlertItem*> sorted_list;
-    for (auto const& iter : token_map)
-        sorted_list.push_back(iter.second);
+    if (base_timestamp == 0) {
+        base_msec = clock->realtimeMsec();
+        base_timestamp = base_msec / 1000;
+    } else {
+        base_msec = (int64_t)base_timestamp * 1000;
+    }
 
-    /* sort alert item by creation order */
-    std::sort(sorted_list.begin(), sorted_list.end(), _compare_creation_time_func);
+    nugu_info("Scheduling! base %zd (%zd changed)", base_timestamp, pending_index.size());
+    dump_time_t(zone, "- NOW ", base_timestamp);
 
-    AlertItem* prev_item = nullptr;
+    /* Only the items changed since the last pass (creation order) */
+    changed_list.swap(pending_index);
 
-    for (auto const& iter : sorted_list) {
+    for (auto const& iter : changed_list) {
         AlertItem* item = iter;
         time_t secs;
+        int64_t fire_msec = 0;
 
         nugu_dbg("token: %s", item->token.c_str());
         nugu_dbg("- activated: %d", item->is_activated);
@@ -457,24 +1503,37 @@ void AlertsManager::scheduling(time_t base_timestamp)
 
         if (item->snooze_secs) {
             if (item->timer_src != 0) {
-                nugu_dbg("- already calculated %d snooze secs (src=%d)",
+                nugu_dbg("- already calculated %d snooze secs (src=%" G_GUINT64_FORMAT ")",
                     item->snooze_secs, item->timer_src);
-                prev_item = item;
                 continue;
             }
 
             secs = item->snooze_secs;
+            fire_msec = relativeDeadline(secs);
             nugu_dbg("- use snooze %d secs", secs);
         } else {
             if (item->timeout_secs != 0) {
-                nugu_dbg("- already calculated %d secs (src=%d)",
+                nugu_dbg("- already calculated %d secs (src=%" G_GUINT64_FORMAT ")",
                     item->timeout_secs, item->timer_src);
-                prev_item = item;
                 continue;
             }
 
-            calculate_timeout(base_timestamp, item);
-            dump_time_t("- candidate ", item->timeout_secs + base_timestamp);
+            /* Completed in the second of the fire. (set to next) */
+            bool fired_now = item->is_repeat && item->fired_msec / 1000 == base_timestamp;
+
+            if (precision_mode) {
+                int64_t from_msec = fired_now ? item->fired_msec + 1 : base_msec;
+
+                fire_msec = from_msec + calculateTimeoutMsec(from_msec, item);
+                item->timeout_secs += from_msec / 1000 - base_timestamp;
+            } else {
+                time_t from = fired_now ? base_timestamp + 1 : base_timestamp;
+
+                calculateTimeout(from, item);
+                item->timeout_secs += from - base_timestamp;
+            }
+
+            dump_time_t(zone, "- candidate ", item->timeout_secs + base_timestamp);
 
             /* Deactivate an alarm that has already timed out. (e.g. reboot) */
             if (item->timeout_secs < 0) {
@@ -485,6 +1544,9 @@ void AlertsManager::scheduling(time_t base_timestamp)
             }
 
             secs = item->timeout_secs;
+
+            if (!precision_mode)
+                fire_msec = (int64_t)(base_timestamp + secs) * 1000;
         }
 
         if (item->asset_secs > 0) {
@@ -495,25 +1557,82 @@ void AlertsManager::scheduling(time_t base_timestamp)
             item->asset_timer_src = addAssetTimeout(asset_secs, item->token);
         }
 
-        item->timer_src = addTimeout(secs, item->token);
+        /* snooze is relative to now, alarm is a wall-clock deadline */
+        item->timer_src = addTimeoutAt(fire_msec, item->token, item->snooze_secs != 0);
 
         item->secs = base_timestamp + secs;
+        item->fire_msec = fire_msec;
 
-        if (prev_item) {
-            if (item->secs == prev_item->secs) {
-                nugu_info("- set ignored flag to %s", prev_item->token.c_str());
-                prev_item->is_ignored = true;
-            }
+        scheduleItem(item);
+    }
+}
+
+/* 1: duplicated, -1: the existing alert should be deactivated, 0: none */
+static int compare_duplication(const AlertItem* existing, const AlertItem* target)
+{
+    /* Duplicate registration is allowed for deactivated alarms. */
+    if (existing->is_activated == false)
+        return 0;
+
+    if (existing->is_repeat) {
+        /* Existing alert: A~D, New alert: E */
+        if (target->is_repeat == false) {
+            nugu_warn("duplicated - same time with reapeating alarm (%s)",
+                existing->token.c_str());
+            return 1;
+        }
+
+        /* Repeated days of the week are exactly the same. */
+        if (existing->wday_bitset == target->wday_bitset) {
+            nugu_warn("duplicated - repeat days 0x%02X (%s)",
+                existing->wday_bitset, existing->token.c_str());
+            return 1;
+        }
+
+        /* Existing: A~D, New: B~D */
+        if (target->wday_count < existing->wday_count) {
+            nugu_warn("repeat day(0x%02X) is smaller than 0x%02X (%s)",
+                target->wday_bitset, existing->wday_bitset, existing->token.c_str());
+            return 1;
         }
 
-        prev_item = item;
+        /* The repeat date range of the new alert item is larger than
+         * the existing alerts. The existing alerts should be deactivate */
+        return -1;
+    }
+
+    /* Existing alert: E, New alert: E */
+    if (target->is_repeat == false) {
+        if (existing->local_secs != target->local_secs)
+            return 0;
+
+        nugu_warn("duplicated - exactly same time %s (%s)",
+            existing->payload->scheduled_time.c_str(),
+            existing->token.c_str());
+        return 1;
     }
+
+    /* Existing alert: E, New alert: A~D
+     * The existing alarm should be deactivate */
+    return -1;
 }
 
 bool AlertsManager::processDuplication(const AlertItem* target)
 {
     std::vector<AlertItem*> deactivate_list;
 
+    if (findDuplication(target, nullptr, deactivate_list))
+        return true;
+
+    for (auto const& iter : deactivate_list)
+        deactivate(iter);
+
+    return false;
+}
+
+/* Check without a change (the excluded tokens are removed in the batch) */
+bool AlertsManager::findDuplication(const AlertItem* target, const std::set<std::string>* excluded, std::vector<AlertItem*>& deactivate_list)
+{
     /* Duplicate registration is allowed for deactivated alarms. */
     if (target->is_activated == false)
         return false;
@@ -525,75 +1644,38 @@ bool AlertsManager::processDuplication(const AlertItem* target)
      * C) Weekend (Repeat 2 days: Sat and Sun)
      * D) Repeat only 1 day of the week
      * E) No repeat
+     *
+     * Only the alerts of the same type at the same H:M:S on the days of
+     * the target are visited. (occupancy_index)
      */
-    for (auto const& iter : token_map) {
-        if (target->token == iter.first)
-            continue;
-
-        AlertItem* existing = iter.second;
-
-        /* Duplicate registration is allowed for deactivated alarms. */
-        if (existing->is_activated == false)
+    for (int wday = 0; wday < 7; wday++) {
+        if ((target->wday_bitset & (1 << wday)) == 0)
             continue;
 
-        /* Required time(H:M:S) is different */
-        if (existing->hms_local_secs != target->hms_local_secs)
+        auto slot = occupancy_index.find(occupancy_key(target->type, wday, target->hms_local_secs));
+        if (slot == occupancy_index.end())
             continue;
 
-        /* No duplicate days of the week */
-        if ((existing->wday_bitset & target->wday_bitset) == 0)
-            continue;
-
-        /* Allow duplicated time alert for different type */
-        if (target->type != existing->type)
-            continue;
-
-        if (existing->is_repeat) {
-            /* Existing alert: A~D, New alert: E */
-            if (target->is_repeat == false) {
-                nugu_warn("duplicated - same time with reapeating alarm (%s)",
-                    existing->token.c_str());
-                return true;
-            }
-
-            /* Repeated days of the week are exactly the same. */
-            if (existing->wday_bitset == target->wday_bitset) {
-                nugu_warn("duplicated - repeat days 0x%02X (%s)",
-                    existing->wday_bitset, existing->token.c_str());
-                return true;
-            }
+        for (auto const& existing : slot->second) {
+            if (target->token == existing->token)
+                continue;
 
-            /* Existing: A~D, New: B~D */
-            if (target->wday_count < existing->wday_count) {
-                nugu_warn("repeat day(0x%02X) is smaller than 0x%02X (%s)",
-                    target->wday_bitset, existing->wday_bitset, existing->token.c_str());
-                return true;
-            }
+            if (excluded && excluded->count(existing->token))
+                continue;
 
-            /* The repeat date range of the new alert item is larger than
-             * the existing alerts. The existing alerts should be deactivate */
-            deactivate_list.push_back(existing);
-        } else {
-            /* Existing alert: E, New alert: E */
-            if (target->is_repeat == false) {
-                if (existing->local_secs != target->local_secs)
-                    continue;
+            /* Already visited on the previous day of the week */
+            if ((existing->wday_bitset & target->wday_bitset & ((1 << wday) - 1)) != 0)
+                continue;
 
-                nugu_warn("duplicated - exactly same time %s (%s)",
-                    existing->scheduled_time.c_str(),
-                    existing->token.c_str());
+            int ret = compare_duplication(existing, target);
+            if (ret > 0)
                 return true;
-            }
 
-            /* Existing alert: E, New alert: A~D
-             * The existing alarm should be deactivate */
-            deactivate_list.push_back(existing);
+            if (ret < 0)
+                deactivate_list.push_back(existing);
         }
     }
 
-    for (auto const& iter : deactivate_list)
-        deactivate(iter);
-
     return false;
 }
 
@@ -607,65 +1689,352 @@ bool AlertsManager::addItem(AlertItem* item)
         return false;
     }
 
-    if (item->type != ALERT_TYPE_ALARM) {
-        /* Remove existing TIMER/SLEEP */
-        for (auto const& iter : token_map) {
-            AlertItem* existing = iter.second;
-            if (existing->type != item->type)
-                continue;
+    /* Remove existing TIMER/SLEEP */
+    if (item->type != ALERT_TYPE_ALARM && single_items[item->type])
+        removeItem(single_items[item->type]->token);
 
-            removeItem(existing->token);
-            break;
-        }
-    }
+    token_index.insert(item);
+    acquireHandle(item);
+    indexItem(item);
+    version++;
 
-    token_map[item->token] = item;
+    appendJournal(AlertsJournal::OP_ADD, item->token, item_json_str(item));
 
     return true;
 }
 
 bool AlertsManager::add(const char* item)
 {
-    Json::Value root;
-    Json::Reader reader;
+    AlertsSetAlertDirective directive;
 
-    if (!reader.parse(item, root)) {
+    if (!item || !AlertsDirectiveParser::parseSetAlert(item, strlen(item), &directive)) {
         nugu_error("parsing error");
         return false;
     }
 
-    return add(root);
+    if (applyAdd(generateAlert(directive)) != AlertsTransaction::STATUS_OK)
+        return false;
+
+    scheduling();
+
+    return true;
 }
 
-bool AlertsManager::add(const Json::Value& item)
+/* add the generated alert (deleted if failed) */
+AlertsTransaction::Status AlertsManager::applyAdd(AlertItem* alert)
 {
-    AlertItem* alert = generateAlert(item);
     if (!alert)
-        return false;
+        return AlertsTransaction::STATUS_FAILED;
 
     if (findItem(alert->token) != NULL) {
         nugu_error("failed! same token");
         delete alert;
-        return false;
+        return AlertsTransaction::STATUS_FAILED;
     }
 
     bool ret = processDuplication(alert);
     if (ret == true) {
         nugu_error("failed! not allowed");
         delete alert;
-        return false;
+        return AlertsTransaction::STATUS_DUPLICATED;
+    }
+
+    if (isFull(alert)) {
+        nugu_error("failed! over the capacity (alarms: %zu, alerts: %zu)", max_alarms, max_alerts);
+        delete alert;
+        return AlertsTransaction::STATUS_FULL;
     }
 
     if (addItem(alert) == false) {
         delete alert;
-        return false;
+        return AlertsTransaction::STATUS_FAILED;
     }
 
+    return AlertsTransaction::STATUS_OK;
+}
+
+/* the new TIMER/SLEEP/ACTION replaces the existing one (not counted) */
+bool AlertsManager::isFull(const AlertItem* alert)
+{
+    if (alert->type != ALERT_TYPE_ALARM && single_items[alert->type])
+        return false;
+
+    if (alert->type == ALERT_TYPE_ALARM && type_counts[ALERT_TYPE_ALARM] >= max_alarms)
+        return true;
+
+    return creation_index.size() >= max_alerts;
+}
+
+bool AlertsManager::add(const Json::Value& item)
+{
+    if (applyAdd(generateAlert(item)) != AlertsTransaction::STATUS_OK)
+        return false;
+
     scheduling();
 
     return true;
 }
 
+/**
+ * Check all the entries in the order of the batch without a change.
+ * The alerts of the adds are generated to prepared. (deleted if failed)
+ */
+bool AlertsManager::validate(AlertsTransaction& txn, std::vector<AlertItem*>& prepared)
+{
+    std::map<std::string, AlertItem*> added;
+    std::set<std::string> removed;
+    AlertItem* singles[ALERT_TYPE_COUNT];
+    size_t alarms = type_counts[ALERT_TYPE_ALARM];
+    size_t alerts = creation_index.size();
+    bool result = true;
+
+    memcpy(singles, single_items, sizeof(singles));
+
+    auto lookup = [&](const std::string& token) -> AlertItem* {
+        auto iter = added.find(token);
+        if (iter != added.end())
+            return iter->second;
+
+        if (removed.count(token))
+            return nullptr;
+
+        return findItem(token);
+    };
+
+    auto drop = [&](AlertItem* item) {
+        if (item->type == ALERT_TYPE_ALARM)
+            alarms--;
+        else if (singles[item->type] == item)
+            singles[item->type] = nullptr;
+
+        alerts--;
+        added.erase(item->token);
+        removed.insert(item->token);
+    };
+
+    prepared.assign(txn.entries.size(), nullptr);
+
+    for (size_t i = 0; i < txn.entries.size(); i++) {
+        AlertsTransaction::Entry& entry = txn.entries[i];
+        std::vector<AlertItem*> deactivate_list;
+        AlertItem* item;
+
+        entry.status = AlertsTransaction::STATUS_OK;
+
+        switch (entry.op) {
+        case AlertsTransaction::OP_ADD:
+            if (entry.token.size() == 0) {
+                nugu_error("There is no token");
+                entry.status = AlertsTransaction::STATUS_FAILED;
+                break;
+            }
+
+            /* same token (also the repeated add in the batch) */
+            if (lookup(entry.token) != nullptr) {
+                nugu_error("failed! same token (%s)", entry.token.c_str());
+                entry.status = AlertsTransaction::STATUS_FAILED;
+                break;
+            }
+
+            item = generateAlert(entry.json);
+            if (!item) {
+                entry.status = AlertsTransaction::STATUS_FAILED;
+                break;
+            }
+
+            prepared[i] = item;
+
+            if (findDuplication(item, &removed, deactivate_list)) {
+                entry.status = AlertsTransaction::STATUS_DUPLICATED;
+                break;
+            }
+
+            for (auto const& iter : added) {
+                AlertItem* other = iter.second;
+
+                if (item->is_activated == false || other->type != item->type
+                    || other->hms_local_secs != item->hms_local_secs
+                    || (other->wday_bitset & item->wday_bitset) == 0)
+                    continue;
+
+                if (compare_duplication(other, item) > 0) {
+                    entry.status = AlertsTransaction::STATUS_DUPLICATED;
+                    break;
+                }
+            }
+
+            if (entry.status != AlertsTransaction::STATUS_OK)
+                break;
+
+            /* the new TIMER/SLEEP/ACTION replaces the existing one */
+            if (item->type != ALERT_TYPE_ALARM && singles[item->type])
+                drop(singles[item->type]);
+
+            if ((item->type == ALERT_TYPE_ALARM && alarms >= max_alarms) || alerts >= max_alerts) {
+                nugu_error("failed! over the capacity (alarms: %zu, alerts: %zu)", max_alarms, max_alerts);
+                entry.status = AlertsTransaction::STATUS_FULL;
+                break;
+            }
+
+            if (item->type == ALERT_TYPE_ALARM)
+                alarms++;
+            else
+                singles[item->type] = item;
+
+            alerts++;
+            added[item->token] = item;
+            removed.erase(item->token);
+            break;
+        case AlertsTransaction::OP_REMOVE:
+            item = lookup(entry.token);
+            if (item == nullptr) {
+                entry.status = AlertsTransaction::STATUS_NOT_FOUND;
+                break;
+            }
+
+            drop(item);
+            break;
+        case AlertsTransaction::OP_SNOOZE:
+            if (lookup(entry.token) == nullptr) {
+                entry.status = AlertsTransaction::STATUS_NOT_FOUND;
+                break;
+            }
+
+            if (entry.secs <= 0)
+                entry.status = AlertsTransaction::STATUS_FAILED;
+            break;
+        }
+
+        /* nothing to apply for the unknown token of a remove */
+        if (entry.status != AlertsTransaction::STATUS_OK
+            && !(entry.op == AlertsTransaction::OP_REMOVE && entry.status == AlertsTransaction::STATUS_NOT_FOUND))
+            result = false;
+    }
+
+    if (result)
+        return true;
+
+    for (size_t i = 0; i < txn.entries.size(); i++) {
+        AlertsTransaction::Entry& entry = txn.entries[i];
+
+        if (entry.status == AlertsTransaction::STATUS_OK)
+            entry.status = AlertsTransaction::STATUS_ABORTED;
+
+        if (prepared[i]) {
+            delete prepared[i];
+            prepared[i] = nullptr;
+        }
+    }
+
+    return false;
+}
+
+bool AlertsManager::commit(AlertsTransaction& txn)
+{
+    std::vector<AlertItem*> prepared;
+    bool result = true;
+
+    nugu_info("commit %zd operations", txn.entries.size());
+
+    if (!validate(txn, prepared)) {
+        nugu_error("the batch is not applied");
+        return false;
+    }
+
+    for (size_t i = 0; i < txn.entries.size(); i++) {
+        AlertsTransaction::Entry& entry = txn.entries[i];
+
+        switch (entry.op) {
+        case AlertsTransaction::OP_ADD:
+            entry.status = applyAdd(prepared[i]);
+            break;
+        case AlertsTransaction::OP_REMOVE:
+            if (entry.status == AlertsTransaction::STATUS_OK && !removeItem(entry.token))
+                entry.status = AlertsTransaction::STATUS_NOT_FOUND;
+            break;
+        case AlertsTransaction::OP_SNOOZE:
+            snooze(findItem(entry.token), entry.secs);
+            break;
+        }
+
+        if (entry.status != AlertsTransaction::STATUS_OK)
+            result = false;
+    }
+
+    /* one scheduling pass for the whole batch */
+    scheduling();
+    dump();
+
+    return result;
+}
+
+void AlertsTransaction::add(const Json::Value& item)
+{
+    Entry entry;
+
+    entry.op = OP_ADD;
+    entry.token = item["token"].asString();
+    entry.json = item;
+    entry.secs = 0;
+    entry.status = STATUS_PENDING;
+
+    entries.push_back(entry);
+}
+
+/* a repeated remove of the same token is NOT_FOUND (one entry per token) */
+void AlertsTransaction::remove(const std::string& token)
+{
+    Entry entry;
+
+    entry.op = OP_REMOVE;
+    entry.token = token;
+    entry.secs = 0;
+    entry.status = STATUS_PENDING;
+
+    entries.push_back(entry);
+}
+
+void AlertsTransaction::snooze(const std::string& token, time_t secs)
+{
+    Entry entry;
+
+    entry.op = OP_SNOOZE;
+    entry.token = token;
+    entry.secs = secs;
+    entry.status = STATUS_PENDING;
+
+    entries.push_back(entry);
+}
+
+bool AlertsTransaction::empty() const
+{
+    return entries.empty();
+}
+
+size_t AlertsTransaction::size() const
+{
+    return entries.size();
+}
+
+const std::vector<AlertsTransaction::Entry>& AlertsTransaction::getEntries() const
+{
+    return entries;
+}
+
+std::vector<std::string> AlertsTransaction::getTokens(Op op, bool succeeded) const
+{
+    std::vector<std::string> tokens;
+
+    for (auto const& entry : entries) {
+        if (entry.op != op || (entry.status == STATUS_OK) != succeeded)
+            continue;
+
+        tokens.push_back(entry.token);
+    }
+
+    return tokens;
+}
+
 bool AlertsManager::removeItem(const std::string& token)
 {
     AlertItem* item = findItem(token);
@@ -674,16 +2043,21 @@ bool AlertsManager::removeItem(const std::string& token)
 
     nugu_info("remove %s", token.c_str());
 
-    token_map.erase(token);
+    token_index.erase(token);
 
-    if (item->is_activated)
-        deactivate(item);
+    /* stop the timers only (the item is deleted) */
+    done(item);
+    unindexItem(item);
+    releaseHandle(item);
+    version++;
+
+    appendJournal(AlertsJournal::OP_REMOVE, token);
 
-    if (item->audioplayer) {
+    if (item->payload->audioplayer) {
         nugu_dbg("remove pending audioplayer");
-        item->audioplayer->deInitialize();
-        delete item->audioplayer;
-        item->audioplayer = nullptr;
+        item->payload->audioplayer->deInitialize();
+        delete item->payload->audioplayer;
+        item->payload->audioplayer = nullptr;
     }
 
     delete item;
@@ -693,41 +2067,65 @@ bool AlertsManager::removeItem(const std::string& token)
 
 AlertItem* AlertsManager::findItem(const std::string& token)
 {
-    try {
-        return token_map.at(token);
-    } catch (const std::out_of_range& e) {
+    return token_index.find(token);
+}
+
+AlertItem* AlertsManager::findItem(const char* token)
+{
+    return token_index.find(token);
+}
+
+AlertItem* AlertsManager::getItem(AlertHandle handle)
+{
+    uint32_t index = (uint32_t)(handle & 0xFFFFFFFF);
+    uint32_t generation = (uint32_t)(handle >> 32);
+
+    if (index == 0)
         return nullptr;
-    }
+
+    std::lock_guard<std::mutex> guard(slot_lock);
+
+    if (index > slots.size() || slots[index - 1].generation != generation)
+        return nullptr;
+
+    return slots[index - 1].item;
 }
 
 void AlertsManager::reset()
 {
     nugu_info("reset all alerts");
 
-    for (auto const& iter : token_map) {
-        nugu_dbg("delete %s", iter.first.c_str());
-        AlertItem* item = iter.second;
-        if (item->is_activated)
-            deactivate(item);
+    /**
+     * Each item is detached from the indexes before it is deleted, and
+     * only OP_RESET is logged (the compaction walks creation_index).
+     */
+    while (!creation_index.empty()) {
+        AlertItem* item = *creation_index.begin();
+
+        nugu_dbg("delete %s", item->token.c_str());
+        token_index.erase(item->token);
+        done(item);
+        unindexItem(item);
+        releaseHandle(item);
         delete item;
     }
 
-    token_map.clear();
+    version++;
+
+    appendJournal(AlertsJournal::OP_RESET, "");
 }
 
 void AlertsManager::dump()
 {
-    int length = token_map.size();
+    int length = token_index.size();
     int i = 1;
 
     nugu_dbg("----------");
-    for (auto const& iter : token_map) {
-        AlertItem* item = iter.second;
-
+    for (auto const& item : creation_index) {
         nugu_info("[%d/%d] %s", i, length, item->token.c_str());
-        nugu_dbg(" - %s", item->json_str.c_str());
-        nugu_dbg(" - timer src: %d (%zd secs, snooze %d secs)",
-            item->timer_src, item->timeout_secs, item->snooze_secs);
+        nugu_dbg(" - %s", item_json_str(item).c_str());
+        nugu_dbg(" - timer src: %" G_GUINT64_FORMAT " (%zd secs, snooze %d secs, at %" G_GINT64_FORMAT " msec)",
+            item->timer_src, item->timeout_secs, item->snooze_secs, item->fire_msec);
         i++;
     }
     nugu_dbg("----------");
@@ -740,6 +2138,9 @@ void AlertsManager::done(AlertItem* item)
 
     nugu_dbg("done %s", item->token.c_str());
 
+    /* timer_src is cleared by the timeout callback once it is fired */
+    unscheduleItem(item, item->timer_src != 0);
+
     removeTimeout(item->timer_src);
     removeTimeout(item->asset_timer_src);
     removeTimeout(item->duration_timer_src);
@@ -749,6 +2150,10 @@ void AlertsManager::done(AlertItem* item)
 
     item->timeout_secs = 0;
     item->snooze_secs = 0;
+
+    /* reschedule on the next scheduling() pass */
+    if (item->is_activated && findItem(item->token) != nullptr)
+        pending_index.insert(item);
 }
 
 void AlertsManager::activate(AlertItem* item)
@@ -760,12 +2165,15 @@ void AlertsManager::activate(AlertItem* item)
 
     nugu_info("activate %s", item->token.c_str());
 
-    Json::FastWriter writer;
-
     item->is_activated = true;
-    item->json["activation"] = true;
-    item->json_str = writer.write(item->json);
-    nugu_dbg("json: %s", item->json_str.c_str());
+    item->payload->activation = true;
+    item->payload->json_dirty = true;
+
+    if (findItem(item->token) != nullptr) {
+        pending_index.insert(item);
+        version++;
+        appendJournal(AlertsJournal::OP_ACTIVATE, item->token);
+    }
 }
 
 void AlertsManager::deactivate(AlertItem* item)
@@ -777,17 +2185,49 @@ void AlertsManager::deactivate(AlertItem* item)
 
     nugu_info("deactivate %s", item->token.c_str());
 
-    Json::FastWriter writer;
-
     item->is_activated = false;
-    item->json["activation"] = false;
-    item->json_str = writer.write(item->json);
-    nugu_dbg("json: %s", item->json_str.c_str());
+    item->payload->activation = false;
+    item->payload->json_dirty = true;
+
+    /* removeItem() logs the removal only */
+    if (findItem(item->token) != nullptr) {
+        version++;
+        appendJournal(AlertsJournal::OP_DEACTIVATE, item->token);
+    }
+}
+
+void AlertsManager::snooze(AlertItem* item, time_t secs)
+{
+    if (!item)
+        return;
+
+    /* Clear previous snooze */
+    if (item->timer_src != 0 || item->snooze_secs != 0) {
+        nugu_dbg("clear previous timer source");
+        done(item);
+    }
+
+    nugu_info("snooze %s (%zd secs)", item->token.c_str(), secs);
+
+    /* Enable the is_activated flag to scheduling (without JSON update) */
+    item->is_activated = true;
+    item->snooze_secs = secs;
+
+    if (findItem(item->token) != nullptr) {
+        pending_index.insert(item);
+        version++;
+        appendJournal(AlertsJournal::OP_SNOOZE, item->token, "", clock->realtimeMsec() / 1000 + secs);
+    }
+}
+
+uint64_t AlertsManager::getVersion()
+{
+    return version;
 }
 
 size_t AlertsManager::getAlertCount()
 {
-    return token_map.size();
+    return token_index.size();
 }
 
 Json::Value AlertsManager::getAlertList(bool is_context)
@@ -795,11 +2235,9 @@ Json::Value AlertsManager::getAlertList(bool is_context)
     Json::Value result;
     Json::FastWriter writer;
 
-    if (!token_map.empty()) {
+    if (!token_index.empty()) {
         int index = 0;
-        for (auto const& iter : token_map) {
-            AlertItem* item = iter.second;
-
+        for (auto const& item : creation_index) {
             if (is_context) {
                 /* Skip the deactivated TIMER/SLEEP item to context list */
                 if (item->type != ALERT_TYPE_ALARM
@@ -807,7 +2245,27 @@ Json::Value AlertsManager::getAlertList(bool is_context)
                     continue;
             }
 
-            result[index] = item->json;
+            result[index] = item_json(item);
+            index++;
+        }
+    }
+
+    return result;
+}
+
+Json::Value AlertsManager::getContextAlertList()
+{
+    Json::Value result;
+
+    if (!token_index.empty()) {
+        int index = 0;
+        for (auto const& item : creation_index) {
+            /* Skip the deactivated TIMER/SLEEP item to context list */
+            if (item->type != ALERT_TYPE_ALARM
+                && item->is_activated == false)
+                continue;
+
+            project_alert(item, result[index]);
             index++;
         }
     }
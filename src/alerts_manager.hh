@@ -18,12 +18,67 @@
 #define __ALERTS_MANAGER_H__
 
 #include "alerts_agent.hh"
+#include "alerts_clock.hh"
+#include "alerts_command_queue.hh"
+#include "alerts_directive_parser.hh"
+#include "alerts_journal.hh"
+#include "alerts_pool.hh"
+#include "alerts_snapshot.hh"
+#include "alerts_timer_wheel.hh"
+#include "alerts_timezone.hh"
+#include "alerts_token_index.hh"
 
 #include <glib.h>
 #include <time.h>
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
 #define DEFAULT_ALARM_DURATION_SEC 180
 
+/**
+ * Default maximum number of ALARM type alerts.
+ * Must have a value less than MAX_ALERTS
+ */
+#define MAX_ALARM 50
+
+/**
+ * Default maximum number of alerts(including ALARM type).
+ * MAX_ALARM + (1 TIMER + 1 SLEEP)
+ */
+#define MAX_ALERTS (MAX_ALARM + 2)
+
+/* Upper bound of the capacity set at runtime (setCapacity) */
+#define MAX_ALERTS_LIMIT 100000
+
+/* alert, asset and duration timer for each alert */
+#define ALERT_TIMERS_PER_ALERT 3
+#define MAX_ALERT_TIMERS (MAX_ALERTS * ALERT_TIMERS_PER_ALERT)
+
+/**
+ * Resolution of the timing wheel (1 tick = 1 msec)
+ *  - normal mode: deadlines are rounded to whole seconds (coalesced wakeups)
+ *  - precision mode: millisecond deadlines (setPrecisionMode)
+ */
+#define TIMER_TICK_MSEC 1
+
+/* Clock offset between anchors treated as a clock change (or slewing) */
+#define CLOCK_DRIFT_MSEC 10
+
+/* Local midnights cached from today (next occurrence within a week) */
+#define LOCAL_DAY_CACHE 8
+
+/* Local day of the scheduling (shared by all the items) */
+typedef struct _AlertsLocalDay {
+    time_t midnight[LOCAL_DAY_CACHE + 1]; /* UTC of the local midnights from today */
+    int64_t days; /* local days since the epoch */
+    int wday; /* 0: SUN ~ 6: SAT */
+} AlertsLocalDay;
+
 /**
  * supported repeat alerts
  *  - Everydat (DAY_ALL)
@@ -46,92 +101,365 @@ enum day {
     DAY_ALL = 0x7F
 };
 
-enum alert_type {
+enum alert_type : uint8_t {
     ALERT_TYPE_TIMER, /* support only 1 timer alert */
     ALERT_TYPE_ALARM,
     ALERT_TYPE_SLEEP, /* support only 1 sleep alert */
     ALERT_TYPE_ACTION
 };
 
-struct _AlertItem {
-    std::string token;
-    bool is_activated;
-    bool is_repeat;
-    bool is_ignored;
-    struct timespec creation_time;
-    std::string json_str; /* original json data */
-    Json::Value json;
+#define ALERT_TYPE_COUNT (ALERT_TYPE_ACTION + 1)
+
+/* alarmResourceType */
+enum alert_resource : uint8_t {
+    ALERT_RESOURCE_INTERNAL,
+    ALERT_RESOURCE_MUSIC,
+    ALERT_RESOURCE_TTS,
+    ALERT_RESOURCE_UNKNOWN
+};
+
+/* Cold data of the alert (not used by the scheduling) */
+typedef struct _AlertItemPayload {
+    std::string json_str; /* original json data (rebuilt on read if json_dirty) */
+    Json::Value json; /* parsed from json_str on demand (json_loaded) */
+    bool json_loaded;
+    bool json_dirty; /* activation is changed after json_str is written */
     std::string scheduled_time;
     std::string ps_id;
-    std::string rsrc_type; /* resource type */
-    bool has_routine;
-    int wday_bitset; /* day-of-week bitset(enum day) */
-    int wday_count;
-    enum alert_type type;
+    std::string rsrc_type; /* resource type (original string) */
     std::string type_str;
+    std::string repeat_type; /* "repeat.type" of the directive */
+    bool activation; /* "activation" of the JSON (not changed by snooze) */
+
+    NuguCapability::AlertsAudioPlayer* audioplayer;
+} AlertItemPayload;
+
+/**
+ * Hot data of the alert (scheduling, duplication check and firing)
+ *  - allocated from the block pool (contiguous records)
+ *  - the payload is allocated separately
+ */
+struct _AlertItem {
+    time_t secs; /* now + (timeout_secs or snooze_secs) */
+    time_t timeout_secs; /* Calculated timestamp to fire */
+    time_t snooze_secs;
     time_t hms_local_secs; /* H:M:S to seconds (local time) */
     time_t local_secs; /* Y-M-D H:M:S to seconds (local time) */
     time_t asset_secs; /* secs of assetRequiredInMilliseconds */
     time_t duration_secs;
-    time_t snooze_secs;
+    int64_t fire_msec; /* deadline armed to the timer (epoch msec) */
+    int64_t fired_msec; /* deadline of the last fire */
+    struct timespec creation_time;
+
+    AlertTimerId timer_src; /* timing wheel id */
+    AlertTimerId asset_timer_src; /* timing wheel id */
+    AlertTimerId duration_timer_src; /* timing wheel id */
+    int16_t frac_msec; /* fractional seconds of scheduledTime (0 ~ 999) */
+    uint8_t wday_bitset; /* day-of-week bitset(enum day) */
+    uint8_t wday_count;
 
+    enum alert_type type;
+    enum alert_resource rsrc;
+    bool is_activated;
+    bool is_repeat;
+    bool is_ignored;
     bool ignored; /* ignored by another alert item */
+    bool is_scheduled; /* registered in the fire time index */
+    bool has_routine;
 
-    time_t timeout_secs; /* Calculated timestamp to fire */
-    time_t secs; /* now + (timeout_secs or snooze_secs) */
+    AlertHandle handle; /* slot map handle (0: not added to the manager) */
+    std::string token;
+    std::unique_ptr<AlertItemPayload> payload;
 
-    guint timer_src; /* GSource id */
-    guint asset_timer_src; /* GSource id */
-    guint duration_timer_src; /* GSource id */
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+};
 
-    NuguCapability::AlertsAudioPlayer* audioplayer;
+/* creation order (oldest first) */
+struct AlertItemCreationOrder {
+    bool operator()(const AlertItem* a, const AlertItem* b) const;
+};
+
+/* nodes of the schedule indexes come from the pools (no heap in the steady state) */
+typedef std::set<AlertItem*, AlertItemCreationOrder, AlertsPoolAllocator<AlertItem*>> AlertItemSet;
+typedef std::multimap<time_t, AlertItem*, std::less<time_t>, AlertsPoolAllocator<std::pair<const time_t, AlertItem*>>> AlertFireIndex;
+
+/* scheduled-versus-actual fire offset of the alert timeouts (msec) */
+typedef struct _AlertsFireStats {
+    unsigned int count;
+    int64_t last;
+    int64_t min;
+    int64_t max;
+    int64_t sum;
+} AlertsFireStats;
+
+/**
+ * Batch of alert operations applied by AlertsManager::commit()
+ *  - all the entries are validated first (token, JSON, duplication and
+ *    the capacity for the net adds) in the order of the batch. The batch
+ *    is applied only if all of them pass (the others are ABORTED)
+ *  - a remove of an unknown (or already removed) token is NOT_FOUND but
+ *    doesn't abort the batch (nothing to apply)
+ *  - operations are applied in order without an intermediate scheduling
+ *  - the status of each entry is filled by commit() (aggregated events)
+ */
+class AlertsTransaction {
+public:
+    enum Op {
+        OP_ADD,
+        OP_REMOVE,
+        OP_SNOOZE
+    };
+
+    enum Status {
+        STATUS_PENDING,
+        STATUS_OK,
+        STATUS_FAILED,
+        STATUS_NOT_FOUND,
+        STATUS_DUPLICATED,
+        STATUS_FULL, /* over the capacity */
+        STATUS_ABORTED /* not applied. the other entry failed */
+    };
+
+    struct Entry {
+        Op op;
+        std::string token;
+        Json::Value json;
+        time_t secs;
+        Status status;
+    };
+
+public:
+    void add(const Json::Value& item);
+    void remove(const std::string& token);
+    void snooze(const std::string& token, time_t secs);
+
+    bool empty() const;
+    size_t size() const;
+    const std::vector<Entry>& getEntries() const;
+    std::vector<std::string> getTokens(Op op, bool succeeded) const;
+
+private:
+    friend class AlertsManager;
+
+    std::vector<Entry> entries;
 };
 
-class AlertsManager {
+class AlertsManager : public IAlertsClockListener {
 public:
-    AlertsManager();
+    /* clock: borrowed (nullptr: the system clock owned by the manager) */
+    explicit AlertsManager(AlertsClock* clock = nullptr);
     virtual ~AlertsManager();
 
     void setListener(IAlertsManagerListener* clistener);
 
-    guint addTimeout(time_t secs, const std::string& token);
-    guint addAssetTimeout(time_t secs, const std::string& token);
-    guint addDurationTimeout(time_t secs, const std::string& token);
-    void removeTimeout(guint timer_src);
+    /* Run the command in the owner context (any thread, lock-free) */
+    bool post(AlertsCommandQueue::Command* command);
+
+    /* Opt-in millisecond deadlines (default: whole seconds) */
+    void setPrecisionMode(bool enable);
+    bool isPrecisionMode();
+
+    /**
+     * Zone name (e.g. "Europe/Berlin"), TZif path or POSIX TZ rule
+     * (default: the device timezone). The date-time of the alerts
+     * added later and the repeat alarms follow the new timezone.
+     */
+    bool setTimezone(const std::string& name);
+    const AlertsTimezone& getTimezone();
+    AlertsFireStats getFireStats();
+    void resetFireStats();
+
+    /**
+     * Maximum number of the alarms and all the alerts (default: MAX_ALARM,
+     * MAX_ALERTS). 1 <= max_alarms <= max_alerts <= MAX_ALERTS_LIMIT.
+     * The record pools and the timer wheel are reserved for max_alerts.
+     * Applied to the alerts added later (the existing ones are kept).
+     */
+    bool setCapacity(size_t max_alarms, size_t max_alerts);
+    size_t getMaxAlarmCount();
+    size_t getMaxAlertCount();
+
+    /* Record pools shared by all the managers (grown by setCapacity) */
+    static AlertsPoolStats getItemPoolStats();
+    static AlertsPoolStats getTimeoutPoolStats();
+
+    AlertTimerId addTimeout(time_t secs, const std::string& token, bool relative = false);
+    AlertTimerId addTimeoutAt(int64_t expire_msec, const std::string& token, bool relative = false);
+    AlertTimerId addAssetTimeout(time_t secs, const std::string& token);
+    AlertTimerId addDurationTimeout(time_t secs, const std::string& token);
+    void removeTimeout(AlertTimerId timer_src);
+
+    /* relative timer of the caller on the clock (owner context) */
+    AlertTimerId addCallbackTimeout(time_t secs, AlertsTimerWheel::TimerFunc func, void* userdata);
 
     AlertItem* generateAlert(const Json::Value& item);
+    AlertItem* generateAlert(const AlertsSetAlertDirective& directive);
+    AlertItem* generateAlert(const AlertsSnapshot& snapshot, size_t index);
     bool processDuplication(const AlertItem* target);
+    /* true if the item can't be added (the same capacity check of add()) */
+    bool isFull(const AlertItem* alert);
     void scheduling(time_t base_timestamp = 0);
 
     bool addItem(AlertItem* item);
     bool removeItem(const std::string& token);
     AlertItem* findItem(const std::string& token);
+    AlertItem* findItem(const char* token);
+
+    /* O(1) lookup. nullptr if the item is already removed (stale handle) */
+    AlertItem* getItem(AlertHandle handle);
 
     bool add(const char* item);
     bool add(const Json::Value& item);
     void reset();
 
+    /**
+     * Validate the batch, apply all operations (or nothing if an entry
+     * fails) and schedule once. true if all succeeded
+     */
+    bool commit(AlertsTransaction& txn);
+
+    /**
+     * Binary snapshot of the alert table (restore without JSON parsing)
+     * journal_seq: the last journal record in the loaded snapshot
+     */
+    bool saveSnapshot(const std::string& path);
+    bool loadSnapshot(const std::string& path, uint64_t* journal_seq = nullptr);
+
+    /**
+     * Restore from <path> (snapshot) and <path>.journal, then append all
+     * the mutations to the journal. (compacted to <path> in background)
+     */
+    bool openJournal(const std::string& path);
+    void syncJournal();
+
     void done(AlertItem* item);
 
     void activate(AlertItem* item);
     void deactivate(AlertItem* item);
+    void snooze(AlertItem* item, time_t secs);
 
     void dump();
 
     size_t getAlertCount();
     Json::Value getAlertList(bool is_context = false);
 
+    /**
+     * Context list built from the typed fields (without assets,
+     * playStackControl, ...). The same items as getAlertList(true).
+     */
+    Json::Value getContextAlertList();
+
+    /* increased on every change of the alert list (starts from 1) */
+    uint64_t getVersion();
+
 private:
-    static gboolean quit_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata);
-    static gboolean timeout_callback(gpointer userdata);
-    static gboolean asset_timeout_callback(gpointer userdata);
-    static gboolean duration_timeout_callback(gpointer userdata);
+    /* IAlertsClockListener */
+    void onClockTimer() override;
+    void onClockChanged() override;
+
+    static gboolean command_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata);
+    static void dispatch_command_func(void* userdata);
+    static void clock_command_func(void* userdata);
+    static void timeout_callback(void* userdata);
+    static void asset_timeout_callback(void* userdata);
+    static void duration_timeout_callback(void* userdata);
+
+    AlertTimerId addWheelTimeout(int64_t expire_msec, const std::string& token, AlertsTimerWheel::TimerFunc func, bool relative = false);
+    int64_t relativeDeadline(time_t secs);
+    const AlertsLocalDay& localDay(time_t now);
+    void calculateTimeout(time_t now, AlertItem* item);
+    int64_t calculateTimeoutMsec(int64_t now_msec, AlertItem* item);
+    void recordFireOffset(int64_t offset);
+    void rearmTimer();
+    void dispatchTimeout();
+    int64_t reanchor();
+    void rescheduleClockChange(int64_t offset);
+    void handleClockChange();
+
+    AlertsTransaction::Status applyAdd(AlertItem* alert);
+    bool findDuplication(const AlertItem* target, const std::set<std::string>* excluded, std::vector<AlertItem*>& deactivate_list);
+    bool validate(AlertsTransaction& txn, std::vector<AlertItem*>& prepared);
+
+    void buildSnapshot(AlertsSnapshotWriter& writer);
+    void replayJournal(const AlertsJournal::Entry& entry);
+    void appendJournal(AlertsJournal::Op op, const std::string& token, const std::string& data = "", int64_t value = 0);
+
+    void acquireHandle(AlertItem* item);
+    void releaseHandle(AlertItem* item);
+    void indexItem(AlertItem* item);
+    void unindexItem(AlertItem* item);
+    void scheduleItem(AlertItem* item);
+    void unscheduleItem(AlertItem* item, bool cancelled);
+    void updateIgnored(time_t secs);
+    void indexOccupancy(AlertItem* item);
+    void unindexOccupancy(AlertItem* item);
 
     IAlertsManagerListener* listener;
-    GMainContext* loop_ctx;
-    int quit_fd;
-    std::map<std::string, int> day_map;
-    std::map<std::string, AlertItem*> token_map;
+    AlertsClock* clock;
+    bool clock_owned;
+
+    /**
+     * Owner context: the thread default context of the creator. The timer
+     * thread of the clock only posts the events to the command queue. The
+     * items, the wheel and the listener are handled in the owner context.
+     */
+    GMainContext* owner_ctx;
+    guint command_src;
+    AlertsCommandQueue commands;
+    AlertsCommandQueue::Command dispatch_command;
+    AlertsCommandQueue::Command clock_command;
+
+    /**
+     * All alert/asset/duration deadlines are driven by one realtime
+     * deadline of the clock. The anchors detect clock changes.
+     */
+    uint64_t armed_tick;
+    uint64_t anchor_realtime;
+    uint64_t anchor_monotonic;
+    std::mutex timer_lock;
+    AlertsTimerWheel wheel;
+    std::vector<AlertsTimerWheel::Expired> dispatching;
+    bool precision_mode;
+    AlertsTimezone zone;
+    AlertsLocalDay local_day;
+    AlertsFireStats fire_stats;
+    AlertsTokenIndex<AlertItem> token_index;
+
+    /**
+     * Slot map of the handles (index + 1 | generation << 32)
+     *  - the generation is increased when the slot is released
+     *  - slot_lock: getItem() may be called from the other threads
+     */
+    struct AlertSlot {
+        AlertItem* item;
+        uint32_t generation;
+    };
+    std::vector<AlertSlot> slots;
+    std::vector<uint32_t> free_slots;
+    std::mutex slot_lock;
+
+    /**
+     * Schedule index (incrementally maintained)
+     *  - creation_index: all items by creation order
+     *  - pending_index: items changed since the last scheduling() pass
+     *  - fire_index: armed items by fire time (secs)
+     */
+    AlertItemSet creation_index;
+    struct timespec last_creation;
+    size_t type_counts[ALERT_TYPE_COUNT];
+    AlertItem* single_items[ALERT_TYPE_COUNT]; /* the only TIMER/SLEEP/ACTION */
+    size_t max_alarms;
+    size_t max_alerts;
+    AlertItemSet pending_index;
+    AlertFireIndex fire_index;
+
+    AlertsJournal* journal;
+    std::string snapshot_path;
+    uint64_t version;
+
+    /* duplicate detection: (type, day of week, H:M:S) => items */
+    std::unordered_map<uint64_t, std::vector<AlertItem*>> occupancy_index;
 };
 
 #endif
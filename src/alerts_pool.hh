@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_POOL_H__
+#define __ALERTS_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+typedef struct _AlertsPoolStats {
+    size_t capacity; /* records in the pool blocks */
+    size_t used; /* records in use (pool + overflow) */
+    size_t peak; /* maximum of used */
+    size_t overflow; /* heap allocations after the pool was exhausted */
+} AlertsPoolStats;
+
+/**
+ * Fixed-capacity pool of the fixed-size records
+ *  - one contiguous block of capacity records (allocated on the first use)
+ *  - reserve() adds a block for the larger capacity
+ *  - released records are reused first (LIFO free list)
+ *  - if exhausted, records are allocated from the heap (stats.overflow)
+ *  - thread-safe (records can be released in another thread)
+ */
+template <typename T>
+class AlertsPool {
+public:
+    explicit AlertsPool(size_t capacity)
+        : free_list(nullptr)
+        , block_used(0)
+    {
+        stats.capacity = capacity;
+        stats.used = 0;
+        stats.peak = 0;
+        stats.overflow = 0;
+    }
+
+    virtual ~AlertsPool()
+    {
+        for (auto const& block : blocks)
+            ::operator delete(block.slots);
+    }
+
+    /* grow to the capacity (never shrinks) */
+    void reserve(size_t capacity)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (capacity <= stats.capacity)
+            return;
+
+        /* the first block is not allocated yet */
+        if (blocks.empty()) {
+            stats.capacity = capacity;
+            return;
+        }
+
+        /* unused records of the last block are moved to the free list */
+        Block& last = blocks.back();
+        while (block_used < last.size) {
+            Slot* slot = &last.slots[block_used++];
+            slot->next = free_list;
+            free_list = slot;
+        }
+
+        addBlock(capacity - stats.capacity);
+        stats.capacity = capacity;
+    }
+
+    void* allocate()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        void* ptr;
+
+        if (blocks.empty() && stats.capacity > 0)
+            addBlock(stats.capacity);
+
+        if (free_list) {
+            ptr = free_list;
+            free_list = free_list->next;
+        } else if (!blocks.empty() && block_used < blocks.back().size) {
+            ptr = &blocks.back().slots[block_used++];
+        } else {
+            ptr = ::operator new(sizeof(T));
+            stats.overflow++;
+        }
+
+        stats.used++;
+        if (stats.used > stats.peak)
+            stats.peak = stats.used;
+
+        return ptr;
+    }
+
+    void release(void* ptr)
+    {
+        if (!ptr)
+            return;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        stats.used--;
+
+        if (!contains(ptr)) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        Slot* slot = (Slot*)ptr;
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+    AlertsPoolStats getStats()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        return stats;
+    }
+
+private:
+    union Slot {
+        Slot* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+    };
+
+    struct Block {
+        Slot* slots;
+        size_t size;
+    };
+
+    void addBlock(size_t size)
+    {
+        Block block;
+
+        block.slots = (Slot*)::operator new(sizeof(Slot) * size);
+        block.size = size;
+        blocks.push_back(block);
+        block_used = 0;
+    }
+
+    bool contains(void* ptr) const
+    {
+        uintptr_t addr = (uintptr_t)ptr;
+
+        for (auto const& block : blocks) {
+            uintptr_t start = (uintptr_t)block.slots;
+
+            if (addr >= start && addr < start + sizeof(Slot) * block.size)
+                return true;
+        }
+
+        return false;
+    }
+
+    std::mutex lock;
+    std::vector<Block> blocks; /* block_used: records used in the last block */
+    Slot* free_list;
+    size_t block_used;
+    AlertsPoolStats stats;
+};
+
+/* Capacity of each node pool of AlertsPoolAllocator (grows only) */
+inline std::atomic<size_t>& alerts_node_capacity(void)
+{
+    static std::atomic<size_t> capacity(0);
+
+    return capacity;
+}
+
+inline void alerts_reserve_nodes(size_t capacity)
+{
+    std::atomic<size_t>& current = alerts_node_capacity();
+    size_t value = current.load();
+
+    while (value < capacity && !current.compare_exchange_weak(value, capacity))
+        ;
+}
+
+/**
+ * Allocator of the node-based containers (std::set, std::multimap)
+ *  - single nodes come from a shared pool of the node type, so insert and
+ *    erase in the steady state don't allocate from the heap
+ *  - the pools grow to alerts_node_capacity() on the next allocation
+ */
+template <typename T>
+class AlertsPoolAllocator {
+public:
+    typedef T value_type;
+
+    AlertsPoolAllocator() = default;
+
+    template <typename U>
+    AlertsPoolAllocator(const AlertsPoolAllocator<U>&)
+    {
+    }
+
+    T* allocate(size_t n)
+    {
+        if (n != 1)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+
+        return static_cast<T*>(pool().allocate());
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        pool().release(ptr);
+    }
+
+    static AlertsPoolStats getStats()
+    {
+        return pool().getStats();
+    }
+
+private:
+    static AlertsPool<T>& pool()
+    {
+        /* never destroyed: nodes may be released after the static destructors */
+        static AlertsPool<T>* nodes = new AlertsPool<T>(0);
+        static std::atomic<size_t> reserved(0);
+        size_t capacity = alerts_node_capacity().load(std::memory_order_relaxed);
+
+        if (capacity > reserved.load(std::memory_order_relaxed)) {
+            nodes->reserve(capacity);
+            reserved.store(capacity, std::memory_order_relaxed);
+        }
+
+        return *nodes;
+    }
+};
+
+template <typename T, typename U>
+inline bool operator==(const AlertsPoolAllocator<T>&, const AlertsPoolAllocator<U>&)
+{
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const AlertsPoolAllocator<T>&, const AlertsPoolAllocator<U>&)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_snapshot.hh"
+
+#include <base/nugu_log.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* CRC-32 (IEEE 802.3) lookup table */
+struct Crc32Table {
+    uint32_t value[256];
+
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+
+            value[i] = c;
+        }
+    }
+};
+
+static bool write_all(int fd, const void* data, size_t length)
+{
+    const uint8_t* pos = (const uint8_t*)data;
+
+    while (length > 0) {
+        ssize_t written = write(fd, pos, length);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        pos += written;
+        length -= written;
+    }
+
+    return true;
+}
+
+AlertsSnapshotWriter::AlertsSnapshotWriter()
+    : journal_seq(0)
+{
+}
+
+AlertsSnapshotWriter::~AlertsSnapshotWriter()
+{
+}
+
+void AlertsSnapshotWriter::append(const AlertsSnapshotRecord& record, const std::string* values)
+{
+    AlertsSnapshotRecord copied = record;
+
+    for (int i = 0; i < SNAPSHOT_FIELD_MAX; i++) {
+        copied.strings[i].offset = string_table.size();
+        copied.strings[i].length = values[i].size();
+        string_table.append(values[i]);
+    }
+
+    records.push_back(copied);
+}
+
+size_t AlertsSnapshotWriter::count() const
+{
+    return records.size();
+}
+
+void AlertsSnapshotWriter::setJournalSeq(uint64_t seq)
+{
+    journal_seq = seq;
+}
+
+bool AlertsSnapshotWriter::save(const std::string& path)
+{
+    AlertsSnapshotHeader header;
+    std::string tmp_path = path + ".tmp";
+    size_t records_size = records.size() * sizeof(AlertsSnapshotRecord);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ALERTS_SNAPSHOT_MAGIC;
+    header.version = ALERTS_SNAPSHOT_VERSION;
+    header.header_size = sizeof(AlertsSnapshotHeader);
+    header.record_size = sizeof(AlertsSnapshotRecord);
+    header.count = records.size();
+    header.strings_size = string_table.size();
+    header.created = time(NULL);
+    header.journal_seq = journal_seq;
+    header.checksum = AlertsSnapshot::crc32(records.data(), records_size);
+    header.checksum = AlertsSnapshot::crc32(string_table.data(), string_table.size(), header.checksum);
+
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        nugu_error("open(%s) failed", tmp_path.c_str());
+        return false;
+    }
+
+    if (!write_all(fd, &header, sizeof(header))
+        || !write_all(fd, records.data(), records_size)
+        || !write_all(fd, string_table.data(), string_table.size())
+        || fsync(fd) < 0) {
+        nugu_error("write(%s) failed", tmp_path.c_str());
+        ::close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    ::close(fd);
+
+    if (rename(tmp_path.c_str(), path.c_str()) < 0) {
+        nugu_error("rename(%s) failed", path.c_str());
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    /* the rename is durable only with the directory */
+    if (!AlertsSnapshot::syncDirectory(path)) {
+        nugu_error("fsync of the directory (%s) failed", path.c_str());
+        return false;
+    }
+
+    nugu_info("snapshot saved: %zd alerts (%s)", records.size(), path.c_str());
+
+    return true;
+}
+
+AlertsSnapshot::AlertsSnapshot()
+    : map(nullptr)
+    , map_size(0)
+    , header(nullptr)
+    , records(nullptr)
+    , strings(nullptr)
+{
+}
+
+AlertsSnapshot::~AlertsSnapshot()
+{
+    close();
+}
+
+uint32_t AlertsSnapshot::crc32(const void* data, size_t length, uint32_t crc)
+{
+    static const Crc32Table table;
+    const uint8_t* pos = (const uint8_t*)data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = table.value[(crc ^ pos[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+bool AlertsSnapshot::syncDirectory(const std::string& path)
+{
+    size_t pos = path.rfind('/');
+    std::string dir = (pos == std::string::npos) ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    bool ret = (fsync(fd) == 0);
+
+    ::close(fd);
+
+    return ret;
+}
+
+bool AlertsSnapshot::open(const std::string& path)
+{
+    struct stat st;
+
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        nugu_dbg("no snapshot (%s)", path.c_str());
+        return false;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(AlertsSnapshotHeader)) {
+        nugu_error("invalid snapshot size");
+        ::close(fd);
+        return false;
+    }
+
+    map_size = st.st_size;
+    map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (map == MAP_FAILED) {
+        nugu_error("mmap failed");
+        map = nullptr;
+        map_size = 0;
+        return false;
+    }
+
+    header = (const AlertsSnapshotHeader*)map;
+
+    if (header->magic != ALERTS_SNAPSHOT_MAGIC
+        || header->version != ALERTS_SNAPSHOT_VERSION
+        || header->header_size < sizeof(AlertsSnapshotHeader)
+        || header->record_size < sizeof(AlertsSnapshotRecord)
+        || (header->record_size % sizeof(int64_t)) != 0) {
+        nugu_error("unsupported snapshot (version %d)", header->version);
+        close();
+        return false;
+    }
+
+    uint64_t records_size = (uint64_t)header->count * header->record_size;
+    if ((uint64_t)header->header_size + records_size + header->strings_size != map_size) {
+        nugu_error("snapshot is truncated");
+        close();
+        return false;
+    }
+
+    records = (const uint8_t*)map + header->header_size;
+    strings = (const char*)records + records_size;
+
+    uint32_t checksum = crc32(records, records_size);
+    checksum = crc32(strings, header->strings_size, checksum);
+    if (checksum != header->checksum) {
+        nugu_error("snapshot checksum mismatch");
+        close();
+        return false;
+    }
+
+    for (size_t i = 0; i < header->count; i++) {
+        const AlertsSnapshotRecord* record = getRecord(i);
+
+        for (int k = 0; k < SNAPSHOT_FIELD_MAX; k++) {
+            if ((uint64_t)record->strings[k].offset + record->strings[k].length > header->strings_size) {
+                nugu_error("invalid string in the record %zd", i);
+                close();
+                return false;
+            }
+        }
+    }
+
+    nugu_info("snapshot loaded: %d alerts (%s)", header->count, path.c_str());
+
+    return true;
+}
+
+void AlertsSnapshot::close()
+{
+    if (map)
+        munmap(map, map_size);
+
+    map = nullptr;
+    map_size = 0;
+    header = nullptr;
+    records = nullptr;
+    strings = nullptr;
+}
+
+size_t AlertsSnapshot::count() const
+{
+    if (!header)
+        return 0;
+
+    return header->count;
+}
+
+uint64_t AlertsSnapshot::getJournalSeq() const
+{
+    if (!header)
+        return 0;
+
+    return header->journal_seq;
+}
+
+const AlertsSnapshotRecord* AlertsSnapshot::getRecord(size_t index) const
+{
+    if (!header || index >= header->count)
+        return nullptr;
+
+    return (const AlertsSnapshotRecord*)(records + index * header->record_size);
+}
+
+std::string AlertsSnapshot::getString(const AlertsSnapshotRecord* record, enum alerts_snapshot_field field) const
+{
+    if (!record || !strings || field >= SNAPSHOT_FIELD_MAX)
+        return "";
+
+    return std::string(strings + record->strings[field].offset, record->strings[field].length);
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_SNAPSHOT_H__
+#define __ALERTS_SNAPSHOT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#define ALERTS_SNAPSHOT_MAGIC 0x534C414E /* "NALS" */
+#define ALERTS_SNAPSHOT_VERSION 4
+
+/**
+ * Binary snapshot of the alert table
+ *
+ * +--------+---------------------------+----------------+
+ * | header | record[0] ... record[n-1] | string table   |
+ * +--------+---------------------------+----------------+
+ *
+ *  - All values are host byte order (the file never leaves the device)
+ *  - checksum: CRC32 of the records and the string table
+ *  - The file is replaced atomically (write to .tmp, fsync, rename, fsync
+ *    of the directory)
+ *  - journal_seq: the last journal record in the snapshot. The replay skips
+ *    the records at or below it (a rotated journal left by a crash)
+ */
+struct AlertsSnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t record_size;
+    uint32_t count;
+    uint32_t strings_size;
+    uint32_t checksum;
+    int64_t created; /* epoch secs */
+    uint64_t journal_seq; /* 0: not a snapshot of the journal */
+};
+
+struct AlertsSnapshotString {
+    uint32_t offset; /* offset in the string table */
+    uint32_t length;
+};
+
+enum alerts_snapshot_field {
+    SNAPSHOT_FIELD_TOKEN,
+    SNAPSHOT_FIELD_JSON,
+    SNAPSHOT_FIELD_SCHEDULED_TIME,
+    SNAPSHOT_FIELD_PS_ID,
+    SNAPSHOT_FIELD_RSRC_TYPE,
+    SNAPSHOT_FIELD_TYPE_STR,
+    SNAPSHOT_FIELD_REPEAT_TYPE,
+    SNAPSHOT_FIELD_MAX
+};
+
+#define SNAPSHOT_FLAG_ACTIVATED 0x01
+#define SNAPSHOT_FLAG_REPEAT 0x02
+#define SNAPSHOT_FLAG_ROUTINE 0x04
+
+/* Parsed alert (the result of generateAlert) */
+struct AlertsSnapshotRecord {
+    int64_t local_secs;
+    int64_t creation_sec;
+    int64_t creation_nsec;
+    int64_t snooze_deadline; /* epoch secs (0: not snoozed) */
+    int32_t hms_local_secs;
+    int32_t asset_secs;
+    int32_t duration_secs;
+    int16_t frac_msec;
+    uint8_t type;
+    uint8_t flags;
+    uint8_t wday_bitset;
+    uint8_t wday_count;
+    uint16_t reserved;
+    AlertsSnapshotString strings[SNAPSHOT_FIELD_MAX];
+};
+
+/* Build a snapshot in memory and save it to the file */
+class AlertsSnapshotWriter {
+public:
+    AlertsSnapshotWriter();
+    virtual ~AlertsSnapshotWriter();
+
+    /* strings: SNAPSHOT_FIELD_MAX entries */
+    void append(const AlertsSnapshotRecord& record, const std::string* strings);
+    size_t count() const;
+    void setJournalSeq(uint64_t seq);
+    bool save(const std::string& path);
+
+private:
+    std::vector<AlertsSnapshotRecord> records;
+    std::string string_table;
+    uint64_t journal_seq;
+};
+
+/* Read-only mmap of a snapshot file */
+class AlertsSnapshot {
+public:
+    AlertsSnapshot();
+    virtual ~AlertsSnapshot();
+
+    /* validate the magic, version, sizes and checksum */
+    bool open(const std::string& path);
+    void close();
+
+    size_t count() const;
+    uint64_t getJournalSeq() const;
+    const AlertsSnapshotRecord* getRecord(size_t index) const;
+    std::string getString(const AlertsSnapshotRecord* record, enum alerts_snapshot_field field) const;
+
+    static uint32_t crc32(const void* data, size_t length, uint32_t crc = 0);
+
+    /* fsync the parent directory of the path (after a rename or create) */
+    static bool syncDirectory(const std::string& path);
+
+private:
+    void* map;
+    size_t map_size;
+    const AlertsSnapshotHeader* header;
+    const uint8_t* records;
+    const char* strings;
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_TIME_PARSER_H__
+#define __ALERTS_TIME_PARSER_H__
+
+#include <stddef.h>
+
+/**
+ * scheduledTime of the alert
+ *  - "HH:MM:SS[.fff]" (repeat alerts)
+ *  - "YYYY-MM-DDTHH:MM:SS[.fff][Z|+HH:MM|+HHMM|+HH]"
+ *  - fractional seconds: 1 ~ 9 digits (truncated to msec)
+ *  - all fields are range checked (day of the month, leap year) and
+ *    no trailing data is allowed
+ */
+typedef struct _AlertsTime {
+    int year; /* 0 if has_date is false */
+    int month; /* 1 ~ 12 */
+    int day; /* 1 ~ 31 */
+    int hour;
+    int minute;
+    int second;
+    int msec;
+    int offset_secs; /* UTC offset (east is positive) */
+    bool has_date;
+    bool has_offset;
+    bool valid;
+} AlertsTime;
+
+/*
+ * C++11 constexpr (single return statement) to be evaluated at compile
+ * time in the tests. Every digit is checked at the fixed position
+ * without scanf.
+ */
+static constexpr int alerts_time_digit(const char* str, size_t length, size_t pos)
+{
+    return (pos < length && str[pos] >= '0' && str[pos] <= '9') ? str[pos] - '0' : -1;
+}
+
+/* count digits at pos (-1 if not a digit) */
+static constexpr int alerts_time_number(const char* str, size_t length, size_t pos, size_t count, int value = 0)
+{
+    return count == 0 ? value
+                      : (alerts_time_digit(str, length, pos) < 0 ? -1
+                                                                 : alerts_time_number(str, length, pos + 1, count - 1,
+                                                                     value * 10 + alerts_time_digit(str, length, pos)));
+}
+
+static constexpr bool alerts_time_range(int value, int min, int max)
+{
+    return value >= min && value <= max;
+}
+
+static constexpr bool alerts_time_char(const char* str, size_t length, size_t pos, char ch)
+{
+    return pos < length && str[pos] == ch;
+}
+
+static constexpr size_t alerts_time_digits_end(const char* str, size_t length, size_t pos)
+{
+    return alerts_time_digit(str, length, pos) < 0 ? pos : alerts_time_digits_end(str, length, pos + 1);
+}
+
+static constexpr bool alerts_time_leap_year(int year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static constexpr int alerts_time_days_in_month(int year, int month)
+{
+    return month == 2 ? (alerts_time_leap_year(year) ? 29 : 28)
+                      : ((month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31);
+}
+
+static constexpr AlertsTime alerts_time_invalid()
+{
+    return AlertsTime { 0, 0, 0, 0, 0, 0, 0, 0, false, false, false };
+}
+
+/* digits from pos to end as msec (scale: 100, 10, 1) */
+static constexpr int alerts_time_frac_msec(const char* str, size_t length, size_t pos, size_t end, int scale = 100)
+{
+    return (pos >= end || scale == 0) ? 0
+                                      : alerts_time_digit(str, length, pos) * scale
+            + alerts_time_frac_msec(str, length, pos + 1, end, scale / 10);
+}
+
+/* "" | "Z" | "+HH" | "+HHMM" | "+HH:MM" (to the end of the string) */
+static constexpr bool alerts_time_offset_valid(const char* str, size_t length, size_t pos)
+{
+    return length - pos == 0
+        || (length - pos == 1 && str[pos] == 'Z')
+        || ((str[pos] == '+' || str[pos] == '-')
+            && alerts_time_range(alerts_time_number(str, length, pos + 1, 2), 0, 23)
+            && (length - pos == 3
+                || (length - pos == 5 && alerts_time_range(alerts_time_number(str, length, pos + 3, 2), 0, 59))
+                || (length - pos == 6 && str[pos + 3] == ':'
+                    && alerts_time_range(alerts_time_number(str, length, pos + 4, 2), 0, 59))));
+}
+
+static constexpr int alerts_time_offset_secs(const char* str, size_t length, size_t pos)
+{
+    return length - pos <= 1 ? 0
+                             : (str[pos] == '-' ? -1 : 1)
+            * (alerts_time_number(str, length, pos + 1, 2) * 3600
+                + (length - pos == 3 ? 0 : alerts_time_number(str, length, length - 2, 2) * 60));
+}
+
+/* '.' followed by 1 ~ 9 digits (or no fraction: frac == end) */
+static constexpr bool alerts_time_frac_valid(size_t frac, size_t end)
+{
+    return end == frac || (end > frac + 1 && end - frac - 1 <= 9);
+}
+
+static constexpr size_t alerts_time_frac_end(const char* str, size_t length, size_t pos)
+{
+    return alerts_time_char(str, length, pos, '.') ? alerts_time_digits_end(str, length, pos + 1) : pos;
+}
+
+static constexpr AlertsTime alerts_time_build(const char* str, size_t length, size_t pos, bool has_date,
+    int year, int month, int day, size_t end)
+{
+    return (alerts_time_frac_valid(pos + 8, end) && alerts_time_offset_valid(str, length, end)
+               && (has_date || end == length))
+        ? AlertsTime { year, month, day,
+              alerts_time_number(str, length, pos, 2),
+              alerts_time_number(str, length, pos + 3, 2),
+              alerts_time_number(str, length, pos + 6, 2),
+              alerts_time_frac_msec(str, length, pos + 9, end),
+              alerts_time_offset_secs(str, length, end),
+              has_date, end < length, true }
+        : alerts_time_invalid();
+}
+
+/* "HH:MM:SS" at pos */
+static constexpr AlertsTime alerts_time_parse_hms(const char* str, size_t length, size_t pos, bool has_date,
+    int year, int month, int day)
+{
+    return (alerts_time_char(str, length, pos + 2, ':') && alerts_time_char(str, length, pos + 5, ':')
+               && alerts_time_range(alerts_time_number(str, length, pos, 2), 0, 23)
+               && alerts_time_range(alerts_time_number(str, length, pos + 3, 2), 0, 59)
+               && alerts_time_range(alerts_time_number(str, length, pos + 6, 2), 0, 59))
+        ? alerts_time_build(str, length, pos, has_date, year, month, day,
+            alerts_time_frac_end(str, length, pos + 8))
+        : alerts_time_invalid();
+}
+
+/* "YYYY-MM-DDT" */
+static constexpr AlertsTime alerts_time_parse_date(const char* str, size_t length)
+{
+    return (alerts_time_char(str, length, 4, '-') && alerts_time_char(str, length, 7, '-')
+               && alerts_time_char(str, length, 10, 'T')
+               && alerts_time_range(alerts_time_number(str, length, 0, 4), 1900, 9999)
+               && alerts_time_range(alerts_time_number(str, length, 5, 2), 1, 12)
+               && alerts_time_range(alerts_time_number(str, length, 8, 2), 1,
+                   alerts_time_days_in_month(alerts_time_number(str, length, 0, 4),
+                       alerts_time_number(str, length, 5, 2))))
+        ? alerts_time_parse_hms(str, length, 11, true,
+            alerts_time_number(str, length, 0, 4),
+            alerts_time_number(str, length, 5, 2),
+            alerts_time_number(str, length, 8, 2))
+        : alerts_time_invalid();
+}
+
+static constexpr AlertsTime alerts_parse_time(const char* str, size_t length)
+{
+    return alerts_time_char(str, length, 4, '-') ? alerts_time_parse_date(str, length)
+                                                 : alerts_time_parse_hms(str, length, 0, false, 0, 0, 0);
+}
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_timer_service.hh"
+
+#include <base/nugu_log.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <vector>
+
+#ifndef G_SOURCE_FUNC
+#define G_SOURCE_FUNC(f) ((GSourceFunc)(void (*)(void))(f))
+#endif
+
+AlertsTimerClient::AlertsTimerClient()
+    : listener(nullptr)
+    , armed(false)
+{
+}
+
+AlertsTimerService& AlertsTimerService::getInstance()
+{
+    /* never destroyed: the clocks may be released after the static destructors */
+    static AlertsTimerService* service = new AlertsTimerService();
+
+    return *service;
+}
+
+AlertsTimerService::AlertsTimerService()
+    : client_count(0)
+    , loop_ctx(nullptr)
+    , quit_fd(-1)
+    , timer_fd(-1)
+{
+}
+
+std::shared_ptr<AlertsTimerClient> AlertsTimerService::registerClient()
+{
+    std::lock_guard<std::mutex> state(state_lock);
+
+    /* the thread is started by the first deadline (arm) */
+    client_count++;
+
+    return std::make_shared<AlertsTimerClient>();
+}
+
+void AlertsTimerService::unregisterClient(const std::shared_ptr<AlertsTimerClient>& client)
+{
+    std::lock_guard<std::mutex> state(state_lock);
+
+    lock.lock();
+    disarm(client);
+    updateTimer();
+    lock.unlock();
+
+    /* wait for the running callback */
+    setListener(client, nullptr);
+
+    /* joined here if the last clock is released */
+    if (--client_count == 0 && timer_thread.joinable())
+        stop();
+}
+
+void AlertsTimerService::setListener(const std::shared_ptr<AlertsTimerClient>& client, IAlertsClockListener* listener)
+{
+    std::lock_guard<std::mutex> guard(client->listener_lock);
+
+    client->listener = listener;
+}
+
+void AlertsTimerService::arm(const std::shared_ptr<AlertsTimerClient>& client, uint64_t expire_msec)
+{
+    if (expire_msec != 0) {
+        std::lock_guard<std::mutex> state(state_lock);
+
+        if (!timer_thread.joinable())
+            start();
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    disarm(client);
+
+    if (expire_msec != 0) {
+        client->deadline = deadlines.insert(std::make_pair(expire_msec, client));
+        client->armed = true;
+    }
+
+    updateTimer();
+}
+
+AlertsTimerServiceStats AlertsTimerService::getStats()
+{
+    std::lock_guard<std::mutex> state(state_lock);
+    std::lock_guard<std::mutex> guard(lock);
+    AlertsTimerServiceStats stats;
+
+    stats.clients = client_count;
+    stats.armed = deadlines.size();
+    stats.running = timer_thread.joinable();
+
+    return stats;
+}
+
+/* lock held */
+void AlertsTimerService::disarm(const std::shared_ptr<AlertsTimerClient>& client)
+{
+    if (!client->armed)
+        return;
+
+    deadlines.erase(client->deadline);
+    client->armed = false;
+}
+
+/* lock held: the timerfd follows the earliest deadline */
+void AlertsTimerService::updateTimer()
+{
+    struct itimerspec spec;
+
+    if (timer_fd < 0)
+        return;
+
+    memset(&spec, 0, sizeof(spec));
+
+    /* zero value disarms the timer */
+    if (deadlines.empty()) {
+        timerfd_settime(timer_fd, 0, &spec, NULL);
+        return;
+    }
+
+    uint64_t expire_msec = deadlines.begin()->first;
+
+    spec.it_value.tv_sec = expire_msec / 1000;
+    spec.it_value.tv_nsec = (expire_msec % 1000) * 1000000;
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL) < 0)
+        nugu_error("timerfd_settime failed");
+}
+
+/* state_lock held */
+void AlertsTimerService::start()
+{
+    nugu_info("start the timer thread");
+
+    quit_fd = eventfd(0, EFD_CLOEXEC);
+    loop_ctx = g_main_context_new();
+
+    lock.lock();
+    timer_fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer_fd < 0)
+        nugu_error("timerfd_create failed");
+    lock.unlock();
+
+    timer_thread = std::thread(&AlertsTimerService::run, this);
+
+    int ret = pthread_setname_np(timer_thread.native_handle(), "alarm_timer");
+    if (ret < 0)
+        nugu_error("pthread_setname_np failed");
+}
+
+/* state_lock held */
+void AlertsTimerService::stop()
+{
+    uint64_t ev = 1;
+
+    int written = write(quit_fd, &ev, sizeof(ev));
+    if (written != sizeof(ev)) {
+        nugu_error("write failed");
+    }
+
+    timer_thread.join();
+
+    lock.lock();
+    if (timer_fd >= 0)
+        close(timer_fd);
+    timer_fd = -1;
+    lock.unlock();
+
+    close(quit_fd);
+    quit_fd = -1;
+
+    g_main_context_unref(loop_ctx);
+    loop_ctx = nullptr;
+}
+
+void AlertsTimerService::run()
+{
+    GMainLoop* loop;
+    GIOChannel* channel;
+    GSource* source;
+
+    loop = g_main_loop_new(loop_ctx, FALSE);
+
+    /* Create event-fd IO watch */
+    channel = g_io_channel_unix_new(quit_fd);
+    source = g_io_create_watch(channel, G_IO_IN);
+    g_source_set_callback(source, G_SOURCE_FUNC(quit_fd_callback), loop, NULL);
+    g_source_attach(source, loop_ctx);
+    g_source_unref(source);
+    g_io_channel_unref(channel);
+
+    /* Create timer-fd IO watch */
+    if (timer_fd >= 0) {
+        channel = g_io_channel_unix_new(timer_fd);
+        source = g_io_create_watch(channel, G_IO_IN);
+        g_source_set_callback(source, G_SOURCE_FUNC(timer_fd_callback), this, NULL);
+        g_source_attach(source, loop_ctx);
+        g_source_unref(source);
+        g_io_channel_unref(channel);
+    }
+
+    nugu_info("start loop");
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+    nugu_info("exit loop");
+}
+
+gboolean AlertsTimerService::quit_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata)
+{
+    nugu_info("quit alert GMainLoop!");
+    g_main_loop_quit((GMainLoop*)userdata);
+    return FALSE;
+}
+
+/* callback in thread context */
+gboolean AlertsTimerService::timer_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata)
+{
+    AlertsTimerService* service = (AlertsTimerService*)userdata;
+    uint64_t expirations;
+    bool changed = false;
+
+    if (read(service->timer_fd, &expirations, sizeof(expirations)) < 0) {
+        /* CLOCK_REALTIME was set (NTP step, manual change, ...) */
+        if (errno == ECANCELED)
+            changed = true;
+        else if (errno != EAGAIN)
+            nugu_error("read failed");
+    }
+
+    service->dispatch(changed);
+
+    return TRUE;
+}
+
+/**
+ * Expired (or all the armed clients for the clock change) are disarmed
+ * and called without the lock, so the listeners can arm again.
+ */
+void AlertsTimerService::dispatch(bool changed)
+{
+    std::vector<std::shared_ptr<AlertsTimerClient>> expired;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t now_msec = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    lock.lock();
+    while (!deadlines.empty() && (changed || deadlines.begin()->first <= now_msec)) {
+        std::shared_ptr<AlertsTimerClient> client = deadlines.begin()->second;
+
+        disarm(client);
+        expired.push_back(client);
+    }
+    updateTimer();
+    lock.unlock();
+
+    for (auto const& client : expired) {
+        std::lock_guard<std::mutex> guard(client->listener_lock);
+
+        if (!client->listener)
+            continue;
+
+        if (changed)
+            client->listener->onClockChanged();
+        else
+            client->listener->onClockTimer();
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_TIMER_SERVICE_H__
+#define __ALERTS_TIMER_SERVICE_H__
+
+#include <glib.h>
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "alerts_clock.hh"
+
+/* Registration of an AlertsSystemClock to the timer service */
+struct AlertsTimerClient {
+    typedef std::multimap<uint64_t, std::shared_ptr<AlertsTimerClient>> Deadlines;
+
+    AlertsTimerClient();
+
+    /* held while the callback is running */
+    std::mutex listener_lock;
+    IAlertsClockListener* listener;
+
+    bool armed;
+    Deadlines::iterator deadline;
+};
+
+typedef struct _AlertsTimerServiceStats {
+    size_t clients; /* registered clocks */
+    size_t armed; /* clocks with a deadline */
+    bool running; /* timer thread */
+} AlertsTimerServiceStats;
+
+/**
+ * Process-wide timer of all the AlertsSystemClock instances
+ *  - one thread, one CLOCK_REALTIME timerfd armed to the earliest deadline
+ *    of all the clients (no wakeups for the idle clients)
+ *  - each client has one deadline and its own listener. The callbacks of
+ *    a client are never called after unregisterClient() returns.
+ *  - the thread is started by the first deadline and joined when the
+ *    last client is unregistered (no thread for the unused clocks)
+ */
+class AlertsTimerService {
+public:
+    static AlertsTimerService& getInstance();
+
+    std::shared_ptr<AlertsTimerClient> registerClient();
+    void unregisterClient(const std::shared_ptr<AlertsTimerClient>& client);
+
+    void setListener(const std::shared_ptr<AlertsTimerClient>& client, IAlertsClockListener* listener);
+
+    /* absolute realtime deadline of the client (0: disarm) */
+    void arm(const std::shared_ptr<AlertsTimerClient>& client, uint64_t expire_msec);
+
+    AlertsTimerServiceStats getStats();
+
+private:
+    AlertsTimerService();
+    virtual ~AlertsTimerService() = default;
+
+    static gboolean quit_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata);
+    static gboolean timer_fd_callback(GIOChannel* channel, GIOCondition cond, gpointer userdata);
+
+    void start();
+    void stop();
+    void run();
+    void dispatch(bool changed);
+    void disarm(const std::shared_ptr<AlertsTimerClient>& client);
+    void updateTimer();
+
+    /* registration and start/stop of the thread */
+    std::mutex state_lock;
+    size_t client_count;
+
+    /* deadlines and the timerfd */
+    std::mutex lock;
+    AlertsTimerClient::Deadlines deadlines;
+
+    GMainContext* loop_ctx;
+    int quit_fd;
+    int timer_fd;
+    std::thread timer_thread;
+};
+
+#endif
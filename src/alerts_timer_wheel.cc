@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_timer_wheel.hh"
+
+#include <string.h>
+
+#define NODE_NONE 0xFFFFFFFF
+
+/* timer id = generation(32 bits) | node index + 1 (32 bits) */
+#define ID_INDEX_BITS 32
+#define ID_INDEX_MASK 0xFFFFFFFFULL
+#define MAX_NODES 0xFFFFFFUL
+
+/* Ticks covered by the whole wheel */
+#define WHEEL_RANGE (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+static inline uint64_t rotate_right(uint64_t bits, unsigned int n)
+{
+    n &= TIMER_WHEEL_MASK;
+    if (n == 0)
+        return bits;
+
+    return (bits >> n) | (bits << (TIMER_WHEEL_SIZE - n));
+}
+
+AlertsTimerWheel::AlertsTimerWheel(uint64_t now_tick)
+    : free_head(NODE_NONE)
+    , now(now_tick)
+    , count(0)
+{
+    memset(heads, 0xFF, sizeof(heads));
+    memset(occupied, 0, sizeof(occupied));
+}
+
+AlertsTimerWheel::~AlertsTimerWheel()
+{
+    clear();
+}
+
+AlertsTimerWheel::TimerId AlertsTimerWheel::makeId(uint32_t index) const
+{
+    return ((TimerId)nodes[index].generation << ID_INDEX_BITS) | (index + 1);
+}
+
+uint32_t AlertsTimerWheel::lookup(TimerId id) const
+{
+    uint32_t index = (uint32_t)(id & ID_INDEX_MASK);
+
+    if (index == 0 || index > nodes.size())
+        return NODE_NONE;
+
+    index--;
+
+    const Node& node = nodes[index];
+    if (!node.used || node.generation != (uint32_t)(id >> ID_INDEX_BITS))
+        return NODE_NONE;
+
+    return index;
+}
+
+void AlertsTimerWheel::place(uint32_t index)
+{
+    Node& node = nodes[index];
+    uint64_t target = node.expire > now ? node.expire : now;
+    uint64_t delta = target - now;
+    int level = 0;
+
+    /* Beyond the wheel range: park in the farthest slot and cascade again */
+    if (delta >= WHEEL_RANGE) {
+        target = now + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+
+    while (level < TIMER_WHEEL_LEVELS - 1
+        && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+
+    uint8_t slot = (target >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+
+    node.level = level;
+    node.slot = slot;
+    node.prev = NODE_NONE;
+    node.next = heads[level][slot];
+
+    if (node.next != NODE_NONE)
+        nodes[node.next].prev = index;
+
+    heads[level][slot] = index;
+    occupied[level] |= (1ULL << slot);
+}
+
+void AlertsTimerWheel::unlink(uint32_t index)
+{
+    Node& node = nodes[index];
+
+    if (node.prev != NODE_NONE)
+        nodes[node.prev].next = node.next;
+    else
+        heads[node.level][node.slot] = node.next;
+
+    if (node.next != NODE_NONE)
+        nodes[node.next].prev = node.prev;
+
+    if (heads[node.level][node.slot] == NODE_NONE)
+        occupied[node.level] &= ~(1ULL << node.slot);
+
+    node.prev = NODE_NONE;
+    node.next = NODE_NONE;
+}
+
+void AlertsTimerWheel::release(uint32_t index)
+{
+    Node& node = nodes[index];
+
+    node.used = false;
+    node.generation++;
+    node.func = nullptr;
+    node.userdata = nullptr;
+    node.destroy = nullptr;
+    node.next = free_head;
+    free_head = index;
+    count--;
+}
+
+AlertsTimerWheel::TimerId AlertsTimerWheel::add(uint64_t expire_tick, TimerFunc func, void* userdata, DestroyFunc destroy, bool relative)
+{
+    uint32_t index;
+
+    if (!func)
+        return 0;
+
+    if (free_head != NODE_NONE) {
+        index = free_head;
+        free_head = nodes[index].next;
+    } else {
+        if (nodes.size() >= MAX_NODES)
+            return 0;
+
+        Node node;
+        memset(&node, 0, sizeof(Node));
+        node.generation = 1;
+
+        nodes.push_back(node);
+        index = nodes.size() - 1;
+    }
+
+    Node& node = nodes[index];
+    node.expire = expire_tick;
+    node.func = func;
+    node.userdata = userdata;
+    node.destroy = destroy;
+    node.used = true;
+    node.relative = relative;
+
+    /* generation 0 is never used to keep the id non-zero */
+    if (node.generation == 0)
+        node.generation = 1;
+
+    place(index);
+    count++;
+
+    return makeId(index);
+}
+
+bool AlertsTimerWheel::remove(TimerId id)
+{
+    uint32_t index = lookup(id);
+    if (index == NODE_NONE)
+        return false;
+
+    Node& node = nodes[index];
+    DestroyFunc destroy = node.destroy;
+    void* userdata = node.userdata;
+
+    unlink(index);
+    release(index);
+
+    if (destroy)
+        destroy(userdata);
+
+    return true;
+}
+
+bool AlertsTimerWheel::contains(TimerId id) const
+{
+    return lookup(id) != NODE_NONE;
+}
+
+bool AlertsTimerWheel::nextExpiry(uint64_t* tick) const
+{
+    uint64_t best = UINT64_MAX;
+
+    if (count == 0)
+        return false;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (occupied[level] == 0)
+            continue;
+
+        unsigned int shift = TIMER_WHEEL_BITS * level;
+        uint64_t base = now >> shift;
+        unsigned int cur_slot = base & TIMER_WHEEL_MASK;
+        uint64_t candidate;
+
+        if (level == 0) {
+            /* level 0 slot == exact expiry tick (may be due now) */
+            candidate = now + __builtin_ctzll(rotate_right(occupied[0], cur_slot));
+        } else {
+            /* upper level slots are always in the future */
+            uint64_t dist = __builtin_ctzll(rotate_right(occupied[level], cur_slot + 1)) + 1;
+            candidate = (base + dist) << shift;
+        }
+
+        if (candidate < best)
+            best = candidate;
+    }
+
+    if (tick)
+        *tick = best;
+
+    return true;
+}
+
+void AlertsTimerWheel::process(uint64_t tick, std::vector<Expired>& expired)
+{
+    /* Cascade upper levels whose slot starts at this tick (top-down) */
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        unsigned int shift = TIMER_WHEEL_BITS * level;
+
+        if ((tick & ((1ULL << shift) - 1)) != 0)
+            continue;
+
+        unsigned int slot = (tick >> shift) & TIMER_WHEEL_MASK;
+        uint32_t index = heads[level][slot];
+        if (index == NODE_NONE)
+            continue;
+
+        heads[level][slot] = NODE_NONE;
+        occupied[level] &= ~(1ULL << slot);
+
+        while (index != NODE_NONE) {
+            uint32_t next = nodes[index].next;
+            place(index);
+            index = next;
+        }
+    }
+
+    unsigned int slot = tick & TIMER_WHEEL_MASK;
+    uint32_t index = heads[0][slot];
+
+    while (index != NODE_NONE) {
+        uint32_t next = nodes[index].next;
+        Node& node = nodes[index];
+
+        if (node.expire <= tick) {
+            Expired item = { makeId(index), node.func, node.userdata, node.destroy };
+
+            unlink(index);
+            release(index);
+            expired.push_back(item);
+        } else {
+            unlink(index);
+            place(index);
+        }
+
+        index = next;
+    }
+}
+
+void AlertsTimerWheel::collect(uint64_t now_tick, std::vector<Expired>& expired)
+{
+    uint64_t tick;
+
+    while (nextExpiry(&tick) && tick <= now_tick) {
+        now = tick;
+        process(tick, expired);
+    }
+
+    if (now_tick > now)
+        now = now_tick;
+}
+
+void AlertsTimerWheel::rebase(uint64_t now_tick, int64_t shift_ticks)
+{
+    memset(heads, 0xFF, sizeof(heads));
+    memset(occupied, 0, sizeof(occupied));
+
+    now = now_tick;
+
+    for (uint32_t index = 0; index < nodes.size(); index++) {
+        Node& node = nodes[index];
+        if (!node.used)
+            continue;
+
+        if (node.relative && shift_ticks != 0) {
+            if (shift_ticks < 0 && node.expire < (uint64_t)-shift_ticks)
+                node.expire = 0;
+            else
+                node.expire += shift_ticks;
+        }
+
+        place(index);
+    }
+}
+
+uint64_t AlertsTimerWheel::current() const
+{
+    return now;
+}
+
+size_t AlertsTimerWheel::size() const
+{
+    return count;
+}
+
+void AlertsTimerWheel::reserve(size_t reserve_count)
+{
+    if (reserve_count > MAX_NODES)
+        reserve_count = MAX_NODES;
+
+    nodes.reserve(reserve_count);
+}
+
+void AlertsTimerWheel::clear()
+{
+    for (uint32_t index = 0; index < nodes.size(); index++) {
+        Node& node = nodes[index];
+        if (!node.used)
+            continue;
+
+        DestroyFunc destroy = node.destroy;
+        void* userdata = node.userdata;
+
+        unlink(index);
+        release(index);
+
+        if (destroy)
+            destroy(userdata);
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_TIMER_WHEEL_H__
+#define __ALERTS_TIMER_WHEEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 6
+
+/**
+ * Hierarchical timing wheel
+ *  - 6 levels of 64 slots. Level N slot covers 64^N ticks.
+ *  - add/remove are O(1) (index linked list + occupancy bitmap)
+ *  - The caller drives the wheel with collect() and uses nextExpiry() to
+ *    arm a single kernel timer for the nearest due slot.
+ *  - Not thread-safe. The owner must serialize the access.
+ */
+class AlertsTimerWheel {
+public:
+    typedef void (*TimerFunc)(void* userdata);
+    typedef void (*DestroyFunc)(void* userdata);
+
+    /* generation(32 bits) | node index + 1 (32 bits). 0: invalid */
+    typedef uint64_t TimerId;
+
+    struct Expired {
+        TimerId id;
+        TimerFunc func;
+        void* userdata;
+        DestroyFunc destroy;
+    };
+
+public:
+    explicit AlertsTimerWheel(uint64_t now_tick = 0);
+    virtual ~AlertsTimerWheel();
+
+    TimerId add(uint64_t expire_tick, TimerFunc func, void* userdata, DestroyFunc destroy = nullptr, bool relative = false);
+    bool remove(TimerId id);
+    bool contains(TimerId id) const;
+
+    /* Move the wheel to now_tick and append all due timers to expired */
+    void collect(uint64_t now_tick, std::vector<Expired>& expired);
+
+    /* Earliest tick that needs a wakeup (slot expiry or cascade) */
+    bool nextExpiry(uint64_t* tick) const;
+
+    /**
+     * Move the wheel to now_tick (also backward) and shift the expiry of
+     * the relative timers by shift_ticks. (e.g. wall-clock change)
+     */
+    void rebase(uint64_t now_tick, int64_t shift_ticks);
+
+    uint64_t current() const;
+    size_t size() const;
+
+    /* Preallocate the timer nodes (no allocation in add() up to count) */
+    void reserve(size_t count);
+    void clear();
+
+private:
+    struct Node {
+        uint64_t expire;
+        TimerFunc func;
+        void* userdata;
+        DestroyFunc destroy;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation;
+        uint8_t level;
+        uint8_t slot;
+        bool used;
+        bool relative;
+    };
+
+    TimerId makeId(uint32_t index) const;
+    uint32_t lookup(TimerId id) const;
+    void place(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void process(uint64_t tick, std::vector<Expired>& expired);
+
+    std::vector<Node> nodes;
+    uint32_t free_head;
+    uint32_t heads[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    uint64_t now;
+    size_t count;
+};
+
+#endif
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alerts_timezone.hh"
+
+#include <base/nugu_log.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#define SECS_PER_DAY 86400
+
+/* TZif files are a few KB */
+#define MAX_TZIF_SIZE (1024 * 1024)
+
+#define TZIF_HEADER_SIZE 44
+
+static int64_t floor_div(int64_t value, int64_t divisor)
+{
+    return value / divisor - ((value % divisor) < 0 ? 1 : 0);
+}
+
+static uint32_t read_be32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int64_t read_be64(const uint8_t* p)
+{
+    return (int64_t)(((uint64_t)read_be32(p) << 32) | read_be32(p + 4));
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data)
+{
+    struct stat st;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    if (fstat(fd, &st) < 0 || st.st_size < TZIF_HEADER_SIZE || st.st_size > MAX_TZIF_SIZE) {
+        ::close(fd);
+        return false;
+    }
+
+    data.resize(st.st_size);
+
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t nread = read(fd, data.data() + offset, data.size() - offset);
+        if (nread <= 0)
+            break;
+
+        offset += nread;
+    }
+
+    ::close(fd);
+
+    return offset == data.size();
+}
+
+AlertsTimezone::AlertsTimezone()
+    : name("UTC")
+    , initial_offset(0)
+    , has_rule(false)
+    , has_dst(false)
+    , std_offset(0)
+    , dst_offset(0)
+    , dst_start()
+    , dst_end()
+{
+}
+
+int64_t AlertsTimezone::daysFromCivil(int year, int month, int day)
+{
+    int64_t y = year - (month <= 2 ? 1 : 0);
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+void AlertsTimezone::civilFromDays(int64_t days, int* year, int* month, int* day)
+{
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400 + (*month <= 2 ? 1 : 0));
+}
+
+int AlertsTimezone::weekday(int64_t days)
+{
+    /* 1970-01-01 is Thursday */
+    int64_t wday = (days + 4) % 7;
+
+    return (int)(wday < 0 ? wday + 7 : wday);
+}
+
+const std::string& AlertsTimezone::getName() const
+{
+    return name;
+}
+
+int AlertsTimezone::offsetAt(time_t utc) const
+{
+    auto iter = std::upper_bound(transitions.begin(), transitions.end(), (int64_t)utc);
+
+    if (iter == transitions.begin())
+        return initial_offset;
+
+    return offsets[iter - transitions.begin() - 1];
+}
+
+time_t AlertsTimezone::toLocal(time_t utc) const
+{
+    return utc + offsetAt(utc);
+}
+
+time_t AlertsTimezone::toUtc(time_t local) const
+{
+    /* offsets before and after a transition near the local time */
+    int before = offsetAt(local - SECS_PER_DAY);
+    int after = offsetAt(local + SECS_PER_DAY);
+
+    time_t utc_before = local - before;
+    time_t utc_after = local - after;
+    bool valid_before = offsetAt(utc_before) == before;
+    bool valid_after = offsetAt(utc_after) == after;
+
+    if (valid_before && valid_after)
+        return std::min(utc_before, utc_after);
+    else if (valid_after)
+        return utc_after;
+
+    /* valid_before or in the gap (the offset before the transition) */
+    return utc_before;
+}
+
+void AlertsTimezone::breakDown(time_t utc, AlertsLocalTime* local) const
+{
+    int offset = offsetAt(utc);
+    int64_t secs = (int64_t)utc + offset;
+    int64_t days = floor_div(secs, SECS_PER_DAY);
+    int64_t day_secs = secs - days * SECS_PER_DAY;
+
+    civilFromDays(days, &local->year, &local->month, &local->day);
+    local->hour = (int)(day_secs / 3600);
+    local->minute = (int)(day_secs % 3600 / 60);
+    local->second = (int)(day_secs % 60);
+    local->wday = weekday(days);
+    local->offset_secs = offset;
+}
+
+bool AlertsTimezone::load(const std::string& zone_name)
+{
+    std::vector<uint8_t> data;
+    std::string path;
+
+    if (zone_name.empty() || zone_name.find("..") != std::string::npos)
+        return false;
+
+    if (zone_name[0] == '/')
+        path = zone_name;
+    else
+        path = std::string(ALERTS_ZONEINFO_DIR) + "/" + zone_name;
+
+    if (!read_file(path, data)) {
+        nugu_dbg("can't read %s", path.c_str());
+        return false;
+    }
+
+    AlertsTimezone zone;
+    if (!zone.parseTZif(data)) {
+        nugu_error("invalid TZif file (%s)", path.c_str());
+        return false;
+    }
+
+    zone.name = zone_name;
+    *this = zone;
+
+    nugu_info("timezone %s (%zd transitions)", name.c_str(), transitions.size());
+
+    return true;
+}
+
+bool AlertsTimezone::loadRule(const std::string& rule)
+{
+    AlertsTimezone zone;
+
+    if (!zone.parseRule(rule)) {
+        nugu_error("invalid TZ rule (%s)", rule.c_str());
+        return false;
+    }
+
+    zone.initial_offset = zone.std_offset;
+    zone.expandRule(1970);
+    zone.name = rule;
+    *this = zone;
+
+    return true;
+}
+
+const AlertsTimezone& AlertsTimezone::local()
+{
+    /* never destroyed: used by the timer thread until the exit */
+    static const AlertsTimezone* zone = []() -> const AlertsTimezone* {
+        AlertsTimezone* local_zone = new AlertsTimezone();
+        const char* tz = getenv("TZ");
+
+        if (tz) {
+            if (*tz == ':')
+                tz++;
+
+            /* empty TZ is UTC */
+            if (*tz == '\0' || local_zone->load(tz) || local_zone->loadRule(tz))
+                return local_zone;
+        } else if (local_zone->load("/etc/localtime")) {
+            return local_zone;
+        }
+
+        nugu_warn("use the default timezone (%s)", ALERTS_DEFAULT_TZ_RULE);
+        local_zone->loadRule(ALERTS_DEFAULT_TZ_RULE);
+
+        return local_zone;
+    }();
+
+    return *zone;
+}
+
+bool AlertsTimezone::parseTZif(const std::vector<uint8_t>& data)
+{
+    const uint8_t* p = data.data();
+    size_t size = data.size();
+    size_t pos = 0;
+    int time_size = 4;
+
+    if (size < TZIF_HEADER_SIZE || memcmp(p, "TZif", 4) != 0)
+        return false;
+
+    /* skip the version 1 data block if there is the 64-bit block */
+    for (int block = 0; block < 2; block++) {
+        uint32_t isutcnt = read_be32(p + pos + 20);
+        uint32_t isstdcnt = read_be32(p + pos + 24);
+        uint32_t leapcnt = read_be32(p + pos + 28);
+        uint32_t timecnt = read_be32(p + pos + 32);
+        uint32_t typecnt = read_be32(p + pos + 36);
+        uint32_t charcnt = read_be32(p + pos + 40);
+        uint64_t data_size = (uint64_t)timecnt * time_size + timecnt + (uint64_t)typecnt * 6 + charcnt
+            + (uint64_t)leapcnt * (time_size + 4) + isstdcnt + isutcnt;
+
+        if (typecnt == 0 || pos + TZIF_HEADER_SIZE + data_size > size)
+            return false;
+
+        if (block == 0 && p[4] >= '2') {
+            pos += TZIF_HEADER_SIZE + data_size;
+            time_size = 8;
+
+            if (pos + TZIF_HEADER_SIZE > size || memcmp(p + pos, "TZif", 4) != 0)
+                return false;
+            continue;
+        }
+
+        const uint8_t* times = p + pos + TZIF_HEADER_SIZE;
+        const uint8_t* indices = times + (size_t)timecnt * time_size;
+        const uint8_t* types = indices + timecnt;
+
+        /* local time type 0 is used before the first transition */
+        initial_offset = (int32_t)read_be32(types);
+
+        transitions.clear();
+        offsets.clear();
+        for (uint32_t i = 0; i < timecnt; i++) {
+            int64_t when = time_size == 8 ? read_be64(times + i * 8) : (int32_t)read_be32(times + i * 4);
+
+            if (indices[i] >= typecnt || (!transitions.empty() && when <= transitions.back()))
+                return false;
+
+            transitions.push_back(when);
+            offsets.push_back((int32_t)read_be32(types + indices[i] * 6));
+        }
+
+        pos += TZIF_HEADER_SIZE + data_size;
+        break;
+    }
+
+    /* footer: "\n<TZ rule>\n" (version 2+) */
+    if (time_size == 8 && pos < size && p[pos] == '\n') {
+        const uint8_t* end = (const uint8_t*)memchr(p + pos + 1, '\n', size - pos - 1);
+
+        if (end && end > p + pos + 1) {
+            std::string rule((const char*)p + pos + 1, end - (p + pos + 1));
+            int first_year = 1970;
+
+            if (!parseRule(rule))
+                return false;
+
+            if (!transitions.empty()) {
+                int month, day;
+
+                civilFromDays(floor_div(transitions.back(), SECS_PER_DAY), &first_year, &month, &day);
+            } else {
+                initial_offset = std_offset;
+            }
+
+            expandRule(first_year);
+        }
+    }
+
+    return true;
+}
+
+/* [+-]hh[:mm[:ss]] */
+static bool parse_rule_time(const char*& cur, int* secs)
+{
+    int sign = 1;
+    int value[3] = { 0, 0, 0 };
+
+    if (*cur == '+' || *cur == '-')
+        sign = (*cur++ == '-') ? -1 : 1;
+
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) {
+            if (*cur != ':')
+                break;
+            cur++;
+        }
+
+        if (*cur < '0' || *cur > '9')
+            return false;
+
+        while (*cur >= '0' && *cur <= '9')
+            value[i] = value[i] * 10 + (*cur++ - '0');
+    }
+
+    /* hours up to 167 (RFC 8536) */
+    if (value[0] > 167 || value[1] > 59 || value[2] > 59)
+        return false;
+
+    *secs = sign * (value[0] * 3600 + value[1] * 60 + value[2]);
+
+    return true;
+}
+
+static bool parse_rule_name(const char*& cur)
+{
+    const char* start = cur;
+
+    if (*cur == '<') {
+        const char* end = strchr(cur, '>');
+        if (!end || end - cur < 2)
+            return false;
+
+        cur = end + 1;
+        return true;
+    }
+
+    while ((*cur >= 'A' && *cur <= 'Z') || (*cur >= 'a' && *cur <= 'z'))
+        cur++;
+
+    return cur - start >= 3;
+}
+
+static bool parse_rule_number(const char*& cur, int* value)
+{
+    if (*cur < '0' || *cur > '9')
+        return false;
+
+    *value = 0;
+    while (*cur >= '0' && *cur <= '9')
+        *value = *value * 10 + (*cur++ - '0');
+
+    return true;
+}
+
+bool AlertsTimezone::parseRule(const std::string& rule)
+{
+    const char* cur = rule.c_str();
+    int secs;
+
+    has_rule = false;
+    has_dst = false;
+
+    /* std offset (POSIX: positive is west of UTC) */
+    if (!parse_rule_name(cur) || !parse_rule_time(cur, &secs))
+        return false;
+
+    std_offset = -secs;
+
+    if (*cur == '\0') {
+        has_rule = true;
+        return true;
+    }
+
+    if (!parse_rule_name(cur))
+        return false;
+
+    dst_offset = std_offset + 3600;
+    if (*cur != ',' && *cur != '\0') {
+        if (!parse_rule_time(cur, &secs))
+            return false;
+
+        dst_offset = -secs;
+    }
+
+    /* default: US rule */
+    const char* dates = (*cur == ',') ? cur + 1 : "M3.2.0,M11.1.0";
+    Rule* targets[2] = { &dst_start, &dst_end };
+
+    for (int i = 0; i < 2; i++) {
+        Rule* target = targets[i];
+
+        if (i == 1) {
+            if (*dates != ',')
+                return false;
+            dates++;
+        }
+
+        if (*dates == 'M') {
+            dates++;
+            target->type = 'M';
+            if (!parse_rule_number(dates, &target->month) || *dates++ != '.'
+                || !parse_rule_number(dates, &target->week) || *dates++ != '.'
+                || !parse_rule_number(dates, &target->day))
+                return false;
+
+            if (target->month < 1 || target->month > 12 || target->week < 1 || target->week > 5
+                || target->day > 6)
+                return false;
+        } else if (*dates == 'J') {
+            dates++;
+            target->type = 'J';
+            if (!parse_rule_number(dates, &target->day) || target->day < 1 || target->day > 365)
+                return false;
+        } else {
+            target->type = 'D';
+            if (!parse_rule_number(dates, &target->day) || target->day > 365)
+                return false;
+        }
+
+        target->time = 2 * 3600;
+        if (*dates == '/') {
+            dates++;
+            if (!parse_rule_time(dates, &target->time))
+                return false;
+        }
+    }
+
+    if (*dates != '\0')
+        return false;
+
+    has_rule = true;
+    has_dst = true;
+
+    return true;
+}
+
+/* local seconds of the rule in the year */
+int64_t AlertsTimezone::ruleTime(const Rule& rule, int year) const
+{
+    int64_t days;
+
+    if (rule.type == 'M') {
+        int64_t first = daysFromCivil(year, rule.month, 1);
+        int64_t next = rule.month == 12 ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, rule.month + 1, 1);
+        int64_t day = (rule.day - weekday(first) + 7) % 7 + (rule.week - 1) * 7;
+
+        /* week 5: the last one of the month */
+        while (first + day >= next)
+            day -= 7;
+
+        days = first + day;
+    } else {
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+        days = daysFromCivil(year, 1, 1) + rule.day;
+
+        /* Jn: 1 ~ 365 without February 29 */
+        if (rule.type == 'J')
+            days += (leap && rule.day >= 60) ? 0 : -1;
+    }
+
+    return days * SECS_PER_DAY + rule.time;
+}
+
+void AlertsTimezone::expandRule(int first_year)
+{
+    if (!has_rule || !has_dst)
+        return;
+
+    for (int year = first_year; year <= ALERTS_TZ_RULE_LAST_YEAR; year++) {
+        int64_t start = ruleTime(dst_start, year) - std_offset;
+        int64_t end = ruleTime(dst_end, year) - dst_offset;
+        int64_t when[2] = { std::min(start, end), std::max(start, end) };
+        int32_t offset[2] = { start < end ? dst_offset : std_offset, start < end ? std_offset : dst_offset };
+
+        for (int i = 0; i < 2; i++) {
+            if (!transitions.empty() && when[i] <= transitions.back())
+                continue;
+
+            transitions.push_back(when[i]);
+            offsets.push_back(offset[i]);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_TIMEZONE_H__
+#define __ALERTS_TIMEZONE_H__
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#define ALERTS_ZONEINFO_DIR "/usr/share/zoneinfo"
+
+/* Last year of the transitions expanded from the TZ rule */
+#define ALERTS_TZ_RULE_LAST_YEAR 2100
+
+/* Used if the local zone can't be loaded (same as the previous behavior) */
+#define ALERTS_DEFAULT_TZ_RULE "KST-9"
+
+/* Local time broken down by AlertsTimezone (without libc) */
+typedef struct _AlertsLocalTime {
+    int year;
+    int month; /* 1 ~ 12 */
+    int day; /* 1 ~ 31 */
+    int hour;
+    int minute;
+    int second;
+    int wday; /* 0: SUN ~ 6: SAT */
+    int offset_secs; /* UTC offset */
+} AlertsLocalTime;
+
+/**
+ * In-memory timezone (UTC offset transition table)
+ *  - loaded once from a TZif file (RFC 8536) or a POSIX TZ rule
+ *  - the TZ rule of the TZif footer is expanded to the transitions up to
+ *    ALERTS_TZ_RULE_LAST_YEAR (DST of the future times)
+ *  - immutable after loading: the conversions are lock-free and never
+ *    call localtime_r()/mktime()
+ *  - "local seconds" are the local wall clock as seconds since the epoch
+ *    (e.g. utc + offset)
+ */
+class AlertsTimezone {
+public:
+    AlertsTimezone(); /* UTC */
+    virtual ~AlertsTimezone() = default;
+
+    /* TZif file path or the zone name (e.g. "Asia/Seoul") */
+    bool load(const std::string& name);
+
+    /* POSIX TZ rule (e.g. "KST-9", "CET-1CEST,M3.5.0,M10.5.0/3") */
+    bool loadRule(const std::string& rule);
+
+    const std::string& getName() const;
+
+    int offsetAt(time_t utc) const;
+    time_t toLocal(time_t utc) const;
+
+    /**
+     * Local seconds to UTC
+     *  - skipped time (DST gap): moved forward by the gap
+     *  - repeated time (DST overlap): the earlier one
+     */
+    time_t toUtc(time_t local) const;
+
+    void breakDown(time_t utc, AlertsLocalTime* local) const;
+
+    /* local zone of the device ($TZ or /etc/localtime) loaded once */
+    static const AlertsTimezone& local();
+
+    /* proleptic Gregorian calendar */
+    static int64_t daysFromCivil(int year, int month, int day);
+    static void civilFromDays(int64_t days, int* year, int* month, int* day);
+    static int weekday(int64_t days);
+
+private:
+    struct Rule {
+        char type; /* 'J', 'D' (zero-based day) or 'M' */
+        int month;
+        int week;
+        int day;
+        int time; /* seconds from the local midnight */
+    };
+
+    bool parseTZif(const std::vector<uint8_t>& data);
+    bool parseRule(const std::string& rule);
+    void expandRule(int first_year);
+    int64_t ruleTime(const Rule& rule, int year) const;
+
+    std::string name;
+    int32_t initial_offset;
+    std::vector<int64_t> transitions; /* sorted UTC */
+    std::vector<int32_t> offsets; /* offset from transitions[i] */
+
+    bool has_rule;
+    bool has_dst;
+    int32_t std_offset;
+    int32_t dst_offset;
+    Rule dst_start;
+    Rule dst_end;
+};
+
+#endif
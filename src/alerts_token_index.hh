@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2019 SK Telecom Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ALERTS_TOKEN_INDEX_H__
+#define __ALERTS_TOKEN_INDEX_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#define TOKEN_INDEX_MIN_CAPACITY 16
+
+/**
+ * Open addressing hash index of the items by token
+ *  - the key is not copied. T::token (std::string) of the item is used.
+ *  - linear probing with backward shift deletion (no tombstone)
+ *  - lookup by (const char*, length) without building a std::string
+ *  - the table grows at 3/4 load. All operations never throw on a miss.
+ */
+template <typename T>
+class AlertsTokenIndex {
+public:
+    AlertsTokenIndex()
+        : count(0)
+    {
+    }
+
+    virtual ~AlertsTokenIndex()
+    {
+    }
+
+    /* FNV-1a */
+    static uint32_t hash(const char* token, size_t length)
+    {
+        uint32_t value = 2166136261u;
+
+        for (size_t i = 0; i < length; i++) {
+            value ^= (uint8_t)token[i];
+            value *= 16777619u;
+        }
+
+        return value;
+    }
+
+    T* find(const char* token, size_t length) const
+    {
+        if (count == 0 || token == nullptr)
+            return nullptr;
+
+        uint32_t value = hash(token, length);
+        size_t mask = slots.size() - 1;
+
+        for (size_t pos = value & mask;; pos = (pos + 1) & mask) {
+            const Slot& slot = slots[pos];
+
+            if (slot.item == nullptr)
+                return nullptr;
+
+            if (slot.hash == value && slot.item->token.size() == length
+                && memcmp(slot.item->token.data(), token, length) == 0)
+                return slot.item;
+        }
+    }
+
+    T* find(const char* token) const
+    {
+        if (token == nullptr)
+            return nullptr;
+
+        return find(token, strlen(token));
+    }
+
+    T* find(const std::string& token) const
+    {
+        return find(token.data(), token.size());
+    }
+
+    /* false if the token already exists */
+    bool insert(T* item)
+    {
+        if (find(item->token) != nullptr)
+            return false;
+
+        if ((count + 1) * 4 > slots.size() * 3)
+            resize(slots.empty() ? TOKEN_INDEX_MIN_CAPACITY : slots.size() * 2);
+
+        place(item, hash(item->token.data(), item->token.size()));
+        count++;
+
+        return true;
+    }
+
+    T* erase(const char* token, size_t length)
+    {
+        if (count == 0)
+            return nullptr;
+
+        uint32_t value = hash(token, length);
+        size_t mask = slots.size() - 1;
+        size_t pos = value & mask;
+
+        while (true) {
+            Slot& slot = slots[pos];
+
+            if (slot.item == nullptr)
+                return nullptr;
+
+            if (slot.hash == value && slot.item->token.size() == length
+                && memcmp(slot.item->token.data(), token, length) == 0)
+                break;
+
+            pos = (pos + 1) & mask;
+        }
+
+        T* item = slots[pos].item;
+
+        /* shift back the following entries of the cluster */
+        size_t hole = pos;
+        for (size_t next = (hole + 1) & mask; slots[next].item != nullptr; next = (next + 1) & mask) {
+            size_t home = slots[next].hash & mask;
+
+            /* move the entry if its home is not in (hole, next] */
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+
+        slots[hole].item = nullptr;
+        slots[hole].hash = 0;
+        count--;
+
+        return item;
+    }
+
+    T* erase(const std::string& token)
+    {
+        return erase(token.data(), token.size());
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    void clear()
+    {
+        slots.clear();
+        count = 0;
+    }
+
+private:
+    struct Slot {
+        uint32_t hash;
+        T* item;
+    };
+
+    void place(T* item, uint32_t value)
+    {
+        size_t mask = slots.size() - 1;
+        size_t pos = value & mask;
+
+        while (slots[pos].item != nullptr)
+            pos = (pos + 1) & mask;
+
+        slots[pos].hash = value;
+        slots[pos].item = item;
+    }
+
+    void resize(size_t capacity)
+    {
+        std::vector<Slot> old;
+
+        old.swap(slots);
+        slots.assign(capacity, Slot { 0, nullptr });
+
+        for (auto const& slot : old) {
+            if (slot.item != nullptr)
+                place(slot.item, slot.hash);
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t count;
+};
+
+#endif
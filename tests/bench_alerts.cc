@@ -0,0 +1,401 @@
+#include <base/nugu_log.h>
+#include <glib.h>
+#include <json/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "alerts_agent.hh"
+#include "alerts_clock.hh"
+#include "alerts_directive_parser.hh"
+#include "alerts_manager.hh"
+
+/**
+ * Benchmark of the AlertsManager hot paths at the table sizes
+ *  - ns/op and operator new calls/op of each operation
+ *  - peak RSS of the process after each size
+ *  - result is printed as JSON (machine-readable)
+ *
+ * usage: bench_alerts [size ...] (default: 50 500 5000 50000)
+ */
+
+/* total alerts visited by each size (rounds = ROUND_ALERTS / size) */
+#define ROUND_ALERTS 100000
+
+/* cached context requests per round */
+#define CONTEXT_REQUESTS 100
+
+#define SET_ALERT_FORMAT                                  \
+    "{"                                                   \
+    "  \"playServiceId\" : \"nugu.builtin.alarm\","       \
+    "  \"token\" : \"%s-%d\","                            \
+    "  \"alertType\" : \"ALARM\","                        \
+    "  \"activation\" : true,"                            \
+    "  \"scheduledTime\" : \"%02d:%02d:%02d\","           \
+    "  \"repeat\" : { \"type\" : \"DAILY\" },"            \
+    "  \"alarmResourceType\" : \"MUSIC\","                \
+    "  \"minDurationInSec\" : 60,"                        \
+    "  \"assetRequiredInMilliseconds\" : 5000,"           \
+    "  \"assets\" : [],"                                  \
+    "  \"playStackControl\" : { \"type\" : \"PUSH\","     \
+    "    \"playServiceId\" : \"nugu.builtin.alarm\" }"    \
+    "}"
+
+static std::atomic<uint64_t> allocations(0);
+
+/* counts the C++ heap allocations (not inlined to the callers) */
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    void* ptr = malloc(size ? size : 1);
+
+    if (!ptr)
+        throw std::bad_alloc();
+
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    return ptr;
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+struct Counter {
+    uint64_t elapsed_ns;
+    uint64_t allocations;
+    uint64_t operations;
+};
+
+class Measure {
+public:
+    explicit Measure(Counter* ccounter)
+        : counter(ccounter)
+        , start_allocations(allocations.load(std::memory_order_relaxed))
+        , start_ns(now_ns())
+    {
+    }
+
+    ~Measure()
+    {
+        counter->elapsed_ns += now_ns() - start_ns;
+        counter->allocations += allocations.load(std::memory_order_relaxed) - start_allocations;
+    }
+
+    static uint64_t now_ns()
+    {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+
+private:
+    Counter* counter;
+    uint64_t start_allocations;
+    uint64_t start_ns;
+};
+
+enum {
+    OP_ADD,
+    OP_GENERATE_ALERT,
+    OP_PROCESS_DUPLICATION,
+    OP_SCHEDULING,
+    OP_REMOVE_ITEM,
+    OP_GET_ALERT_LIST,
+    OP_CONTEXT_REBUILD,
+    OP_CONTEXT,
+    OP_FIRE,
+    OP_MAX
+};
+
+static const char* OP_NAMES[OP_MAX] = {
+    "add",
+    "generateAlert",
+    "processDuplication",
+    "scheduling",
+    "removeItem",
+    "getAlertList",
+    "updateInfoForContext.rebuild",
+    "updateInfoForContext",
+    "fire",
+};
+
+static std::string set_alert_message(const char* prefix, int index)
+{
+    char buf[1024];
+    int hms = (index * 7) % 86400; /* unique H:M:S (7 is coprime to 86400) */
+
+    snprintf(buf, sizeof(buf), SET_ALERT_FORMAT, prefix, index, hms / 3600, hms / 60 % 60, hms % 60);
+
+    return buf;
+}
+
+static std::string alert_token(const char* prefix, int index)
+{
+    return std::string(prefix) + "-" + std::to_string(index);
+}
+
+static bool bench_manager(int size, const std::vector<std::string>& messages,
+    const std::vector<AlertsSetAlertDirective>& duplicates, Counter* counters)
+{
+    AlertsManager manager;
+    std::vector<AlertItem*> items(size);
+
+    if (!manager.setCapacity(size, size))
+        return false;
+
+    {
+        Measure measure(&counters[OP_ADD]);
+
+        for (int i = 0; i < size; i++)
+            if (!manager.add(messages[i].c_str()))
+                return false;
+    }
+    counters[OP_ADD].operations += size;
+
+    /* same H:M:S of the existing alerts with the other tokens */
+    {
+        Measure measure(&counters[OP_GENERATE_ALERT]);
+
+        for (int i = 0; i < size; i++)
+            items[i] = manager.generateAlert(duplicates[i]);
+    }
+    counters[OP_GENERATE_ALERT].operations += size;
+
+    {
+        Measure measure(&counters[OP_PROCESS_DUPLICATION]);
+
+        for (int i = 0; i < size; i++)
+            if (!items[i] || !manager.processDuplication(items[i]))
+                return false;
+    }
+    counters[OP_PROCESS_DUPLICATION].operations += size;
+
+    for (auto item : items)
+        delete item;
+
+    /* reschedule all the alerts in one pass */
+    for (int i = 0; i < size; i++)
+        manager.activate(manager.findItem(alert_token("bench", i)));
+
+    {
+        Measure measure(&counters[OP_SCHEDULING]);
+
+        manager.scheduling(time(NULL));
+    }
+    counters[OP_SCHEDULING].operations += size;
+
+    {
+        Measure measure(&counters[OP_GET_ALERT_LIST]);
+
+        if (manager.getAlertList().size() != (unsigned int)size)
+            return false;
+    }
+    counters[OP_GET_ALERT_LIST].operations++;
+
+    std::vector<std::string> tokens(size);
+    for (int i = 0; i < size; i++)
+        tokens[i] = alert_token("bench", i);
+
+    {
+        Measure measure(&counters[OP_REMOVE_ITEM]);
+
+        for (int i = 0; i < size; i++)
+            if (!manager.removeItem(tokens[i]))
+                return false;
+    }
+    counters[OP_REMOVE_ITEM].operations += size;
+
+    return true;
+}
+
+static bool bench_agent(int size, const Json::Value& alerts, Counter* counters)
+{
+    AlertsAgent agent;
+    Json::Value ctx;
+
+    if (!agent.setAlertCapacity(size, size) || !agent.addAlerts(alerts))
+        return false;
+
+    /* the first request after the changes builds the context */
+    {
+        Measure measure(&counters[OP_CONTEXT_REBUILD]);
+
+        agent.updateInfoForContext(ctx);
+    }
+    counters[OP_CONTEXT_REBUILD].operations++;
+
+    {
+        Measure measure(&counters[OP_CONTEXT]);
+
+        for (int i = 0; i < CONTEXT_REQUESTS; i++)
+            agent.updateInfoForContext(ctx);
+    }
+    counters[OP_CONTEXT].operations += CONTEXT_REQUESTS;
+
+    return agent.getAlertCount() == size;
+}
+
+class FireListener : public IAlertsManagerListener {
+public:
+    explicit FireListener(AlertsManager* cmanager)
+        : manager(cmanager)
+        , fired(0)
+    {
+    }
+
+    void onTimeout(const std::string& token) override
+    {
+        manager->done(manager->findItem(token));
+        manager->scheduling();
+        fired++;
+    }
+    void onAssetRequireTimeout(const std::string& token) override
+    {
+    }
+    void onDurationTimeout(const std::string& token) override
+    {
+    }
+
+    AlertsManager* manager;
+    int fired;
+};
+
+/* a day of the alarms on the virtual clock (fire and re-arm) */
+static bool bench_fire(int size, const std::vector<std::string>& messages, Counter* counters)
+{
+    AlertsVirtualClock clock((uint64_t)time(NULL) * 1000);
+    AlertsManager manager(&clock);
+    FireListener listener(&manager);
+
+    if (!manager.setCapacity(size, size))
+        return false;
+
+    manager.setListener(&listener);
+
+    for (int i = 0; i < size; i++)
+        if (!manager.add(messages[i].c_str()))
+            return false;
+
+    {
+        Measure measure(&counters[OP_FIRE]);
+
+        clock.advance(86400ULL * 1000);
+    }
+    counters[OP_FIRE].operations += size;
+
+    return listener.fired == size;
+}
+
+static bool bench_size(int size, Json::Value& result)
+{
+    std::vector<std::string> messages(size);
+    std::vector<std::string> duplicate_messages(size);
+    std::vector<AlertsSetAlertDirective> duplicates(size); /* slices of duplicate_messages */
+    Json::Value alerts(Json::arrayValue);
+    Json::Reader reader;
+    Counter counters[OP_MAX];
+    int rounds = ROUND_ALERTS / size;
+
+    if (rounds < 1)
+        rounds = 1;
+
+    memset(counters, 0, sizeof(counters));
+
+    for (int i = 0; i < size; i++) {
+        const std::string& duplicate = duplicate_messages[i] = set_alert_message("dup", i);
+        Json::Value alert;
+
+        messages[i] = set_alert_message("bench", i);
+
+        if (!AlertsDirectiveParser::parseSetAlert(duplicate.c_str(), duplicate.size(), &duplicates[i])
+            || !reader.parse(messages[i], alert))
+            return false;
+
+        alerts.append(alert);
+    }
+
+    for (int round = 0; round < rounds; round++) {
+        if (!bench_manager(size, messages, duplicates, counters)) {
+            fprintf(stderr, "manager failed (size %d)\n", size);
+            return false;
+        }
+
+        if (!bench_agent(size, alerts, counters)) {
+            fprintf(stderr, "agent failed (size %d)\n", size);
+            return false;
+        }
+
+        if (!bench_fire(size, messages, counters)) {
+            fprintf(stderr, "fire failed (size %d)\n", size);
+            return false;
+        }
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    result["alerts"] = size;
+    result["rounds"] = rounds;
+
+    for (int i = 0; i < OP_MAX; i++) {
+        Json::Value& op = result["operations"][OP_NAMES[i]];
+
+        op["ops"] = (Json::UInt64)counters[i].operations;
+        op["ns_per_op"] = (double)counters[i].elapsed_ns / counters[i].operations;
+        op["allocs_per_op"] = (double)counters[i].allocations / counters[i].operations;
+    }
+
+    result["peak_rss_kb"] = (Json::Int64)usage.ru_maxrss;
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<int> sizes = { 50, 500, 5000, 50000 };
+    Json::Value output;
+    Json::StyledWriter writer;
+
+    if (argc > 1) {
+        sizes.clear();
+
+        for (int i = 1; i < argc; i++) {
+            int size = atoi(argv[i]);
+
+            if (size <= 0 || size > 86400) {
+                printf("usage: %s [size(1 ~ 86400) ...]\n", argv[0]);
+                return -1;
+            }
+
+            sizes.push_back(size);
+        }
+    }
+
+    nugu_log_set_system(NUGU_LOG_SYSTEM_NONE);
+
+    output["benchmark"] = "bench_alerts";
+    output["results"] = Json::Value(Json::arrayValue);
+
+    for (auto size : sizes) {
+        Json::Value result;
+
+        if (!bench_size(size, result))
+            return -1;
+
+        output["results"].append(result);
+    }
+
+    printf("%s", writer.write(output).c_str());
+
+    return 0;
+}
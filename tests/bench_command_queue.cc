@@ -0,0 +1,168 @@
+#include <glib.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "alerts_command_queue.hh"
+
+/**
+ * Micro-benchmark: post-to-run throughput and latency of the lock-free
+ * command queue compared with a mutex + condition variable queue.
+ *  - N producer threads post M commands each, one consumer runs them
+ */
+
+#define DEFAULT_PRODUCERS 4
+#define DEFAULT_COUNT 100000
+
+struct BenchCommand {
+    AlertsCommandQueue::Command command;
+    gint64 posted;
+};
+
+struct BenchResult {
+    double ns_per_op;
+    double avg_latency_us;
+    gint64 max_latency_us;
+};
+
+static gint64 latency_sum;
+static gint64 latency_max;
+
+static void _run_command(void* userdata)
+{
+    BenchCommand* bc = (BenchCommand*)userdata;
+    gint64 latency = g_get_monotonic_time() - bc->posted;
+
+    latency_sum += latency;
+    if (latency > latency_max)
+        latency_max = latency;
+}
+
+static BenchResult bench_lockfree(int producers, int count)
+{
+    AlertsCommandQueue queue;
+    std::vector<BenchCommand> commands(producers * count);
+    std::vector<std::thread> threads;
+    size_t total = commands.size();
+    size_t executed = 0;
+    struct pollfd pfd = { queue.getFd(), POLLIN, 0 };
+
+    for (auto& bc : commands) {
+        bc.command.func = _run_command;
+        bc.command.userdata = &bc;
+    }
+
+    latency_sum = 0;
+    latency_max = 0;
+
+    gint64 start = g_get_monotonic_time();
+
+    for (int t = 0; t < producers; t++) {
+        threads.push_back(std::thread([&, t] {
+            for (int i = 0; i < count; i++) {
+                BenchCommand& bc = commands[t * count + i];
+                bc.posted = g_get_monotonic_time();
+                queue.post(&bc.command);
+            }
+        }));
+    }
+
+    /* owner loop: wait for the eventfd and drain */
+    while (executed < total) {
+        poll(&pfd, 1, 10);
+        executed += queue.drain();
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return { (double)elapsed * 1000 / total, (double)latency_sum / total, latency_max };
+}
+
+static BenchResult bench_mutex(int producers, int count)
+{
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<BenchCommand*> queue;
+    std::vector<BenchCommand> commands(producers * count);
+    std::vector<std::thread> threads;
+    size_t total = commands.size();
+    size_t executed = 0;
+
+    latency_sum = 0;
+    latency_max = 0;
+
+    gint64 start = g_get_monotonic_time();
+
+    for (int t = 0; t < producers; t++) {
+        threads.push_back(std::thread([&, t] {
+            for (int i = 0; i < count; i++) {
+                BenchCommand& bc = commands[t * count + i];
+                bc.posted = g_get_monotonic_time();
+
+                std::lock_guard<std::mutex> guard(lock);
+                queue.push_back(&bc);
+                cond.notify_one();
+            }
+        }));
+    }
+
+    while (executed < total) {
+        std::deque<BenchCommand*> batch;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cond.wait_for(guard, std::chrono::milliseconds(10), [&] { return !queue.empty(); });
+            batch.swap(queue);
+        }
+
+        for (auto const& bc : batch) {
+            _run_command(bc);
+            executed++;
+        }
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return { (double)elapsed * 1000 / total, (double)latency_sum / total, latency_max };
+}
+
+static void print_result(const char* name, const BenchResult& result)
+{
+    printf("%-8s %8.1f ns/op, latency avg %8.1f us, max %6" G_GINT64_FORMAT " us\n",
+        name, result.ns_per_op, result.avg_latency_us, result.max_latency_us);
+}
+
+int main(int argc, char* argv[])
+{
+    int producers = DEFAULT_PRODUCERS;
+    int count = DEFAULT_COUNT;
+
+    if (argc > 1)
+        producers = atoi(argv[1]);
+    if (argc > 2)
+        count = atoi(argv[2]);
+
+    if (producers <= 0 || count <= 0) {
+        printf("usage: %s [producers] [count]\n", argv[0]);
+        return -1;
+    }
+
+    printf("producers: %d, commands per producer: %d\n", producers, count);
+    print_result("lockfree", bench_lockfree(producers, count));
+    print_result("mutex", bench_mutex(producers, count));
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <glib.h>
+#include <json/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+
+#include "alerts_directive_parser.hh"
+
+/**
+ * Micro-benchmark: SetAlert field extraction of the streaming parser
+ * compared with the previous path (Json::Reader DOM, field reads,
+ * FastWriter re-serialization and "Routine.Start" search).
+ */
+
+#define DEFAULT_COUNT 100000
+
+#define SET_ALERT_MESSAGE                                                             \
+    "{"                                                                               \
+    "  \"playServiceId\" : \"nugu.builtin.alarm\","                                   \
+    "  \"token\" : \"7f2c0b3a-2f7e-4c71-9f0e-8a1d3c5b6e70\","                         \
+    "  \"alertType\" : \"ALARM\","                                                    \
+    "  \"activation\" : true,"                                                        \
+    "  \"scheduledTime\" : \"07:30:00\","                                             \
+    "  \"repeat\" : { \"type\" : \"WEEKLY\","                                         \
+    "    \"daysOfWeek\" : [ \"MON\", \"TUE\", \"WED\", \"THU\", \"FRI\" ] },"         \
+    "  \"alarmResourceType\" : \"MUSIC\","                                            \
+    "  \"minDurationInSec\" : 60,"                                                    \
+    "  \"assetRequiredInMilliseconds\" : 5000,"                                       \
+    "  \"assets\" : [ {"                                                              \
+    "    \"header\" : { \"namespace\" : \"AudioPlayer\", \"name\" : \"Play\","        \
+    "      \"dialogRequestId\" : \"d0c5e1f2\", \"messageId\" : \"m1\" },"             \
+    "    \"payload\" : { \"playServiceId\" : \"nugu.builtin.music\","                 \
+    "      \"audioItem\" : { \"stream\" : { \"url\" : \"https://example.com/a.mp3\"," \
+    "        \"offsetInMilliseconds\" : 0, \"token\" : \"stream-token\" } } }"        \
+    "  } ],"                                                                          \
+    "  \"playStackControl\" : { \"type\" : \"PUSH\","                                 \
+    "    \"playServiceId\" : \"nugu.builtin.alarm\" }"                                \
+    "}"
+
+static size_t sink;
+
+static double bench_jsoncpp(const char* message, int count)
+{
+    std::map<std::string, int> day_map = {
+        { "MON", 1 }, { "TUE", 2 }, { "WED", 3 }, { "THU", 4 },
+        { "FRI", 5 }, { "SAT", 6 }, { "SUN", 0 }
+    };
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < count; i++) {
+        Json::Value root;
+        Json::Reader reader;
+        Json::FastWriter writer;
+
+        if (!reader.parse(message, root))
+            return -1;
+
+        std::string ps_id = root["playServiceId"].asString();
+        std::string token = root["token"].asString();
+        std::string type = root["alertType"].asString();
+        std::string scheduled_time = root["scheduledTime"].asString();
+        std::string rsrc_type = root["alarmResourceType"].asString();
+        bool activation = root["activation"].asBool();
+        int wday_bitset = 0;
+
+        if (root.isMember("repeat")) {
+            Json::Value days = root["repeat"]["daysOfWeek"];
+            for (int d = 0; d < (int)days.size(); d++)
+                wday_bitset |= 1 << day_map.at(days[d].asString());
+        }
+
+        std::string json_str = writer.write(root);
+        bool has_routine = json_str.find("Routine.Start") != std::string::npos;
+
+        sink += ps_id.size() + token.size() + type.size() + scheduled_time.size() + rsrc_type.size()
+            + activation + wday_bitset + has_routine + root["assets"].size()
+            + root["minDurationInSec"].asInt() + json_str.size();
+    }
+
+    return (double)(g_get_monotonic_time() - start) * 1000 / count;
+}
+
+static double bench_streaming(const char* message, int count)
+{
+    size_t length = strlen(message);
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < count; i++) {
+        AlertsSetAlertDirective directive;
+
+        if (!AlertsDirectiveParser::parseSetAlert(message, length, &directive))
+            return -1;
+
+        /* json_str is the copy of the message */
+        std::string json_str(directive.raw, directive.raw_length);
+        bool has_routine = json_str.find("Routine.Start") != std::string::npos;
+
+        sink += directive.ps_id.size() + directive.token.size() + directive.type.size()
+            + directive.scheduled_time.size() + directive.rsrc_type.size()
+            + directive.activation + directive.wday_bitset + has_routine + directive.has_assets
+            + directive.min_duration_sec + json_str.size();
+    }
+
+    return (double)(g_get_monotonic_time() - start) * 1000 / count;
+}
+
+int main(int argc, char* argv[])
+{
+    int count = DEFAULT_COUNT;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+
+    if (count <= 0) {
+        printf("usage: %s [count]\n", argv[0]);
+        return -1;
+    }
+
+    printf("SetAlert messages: %d (%zd bytes)\n", count, strlen(SET_ALERT_MESSAGE));
+    printf("jsoncpp   %8.1f ns/op\n", bench_jsoncpp(SET_ALERT_MESSAGE, count));
+    printf("streaming %8.1f ns/op\n", bench_streaming(SET_ALERT_MESSAGE, count));
+
+    return sink == 0;
+}
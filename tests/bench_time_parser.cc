@@ -0,0 +1,79 @@
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alerts_time_parser.hh"
+
+/**
+ * Micro-benchmark: scheduledTime parsing of alerts_parse_time() compared
+ * with the previous sscanf() path.
+ */
+
+#define DEFAULT_COUNT 1000000
+
+static const char* TIMES[] = {
+    "07:30:00",
+    "23:59:59.250",
+    "2021-04-30T15:07:05",
+    "2024-02-29T06:00:00.125+09:00",
+};
+
+#define TIME_COUNT (sizeof(TIMES) / sizeof(TIMES[0]))
+
+static long sink;
+
+static double bench_sscanf(int count)
+{
+    gint64 start = g_get_monotonic_time();
+
+    for (int i = 0; i < count; i++) {
+        const char* str = TIMES[i % TIME_COUNT];
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+
+        if (str[4] == '-')
+            sscanf(str, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second);
+        else
+            sscanf(str, "%d:%d:%d", &hour, &minute, &second);
+
+        sink += year + month + day + hour + minute + second;
+    }
+
+    return (double)(g_get_monotonic_time() - start) * 1000 / count;
+}
+
+static double bench_parser(int count)
+{
+    size_t lengths[TIME_COUNT];
+    gint64 start = g_get_monotonic_time();
+
+    for (size_t i = 0; i < TIME_COUNT; i++)
+        lengths[i] = strlen(TIMES[i]);
+
+    for (int i = 0; i < count; i++) {
+        AlertsTime t = alerts_parse_time(TIMES[i % TIME_COUNT], lengths[i % TIME_COUNT]);
+
+        sink += t.year + t.month + t.day + t.hour + t.minute + t.second + t.msec + t.offset_secs + t.valid;
+    }
+
+    return (double)(g_get_monotonic_time() - start) * 1000 / count;
+}
+
+int main(int argc, char* argv[])
+{
+    int count = DEFAULT_COUNT;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+
+    if (count <= 0) {
+        printf("usage: %s [count]\n", argv[0]);
+        return -1;
+    }
+
+    printf("scheduledTime: %d\n", count);
+    printf("sscanf  %8.1f ns/op\n", bench_sscanf(count));
+    printf("parser  %8.1f ns/op (validated)\n", bench_parser(count));
+
+    return sink == 0;
+}
@@ -0,0 +1,129 @@
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "alerts_timer_wheel.hh"
+
+/**
+ * Micro-benchmark: arm/cancel cost of the timing wheel compared with the
+ * previous per-alert GSource path (g_timeout_source_new_seconds +
+ * g_main_context_find_source_by_id).
+ */
+
+#define DEFAULT_COUNT 1000
+#define DEFAULT_ROUNDS 100
+
+struct timeout_data {
+    int dummy;
+};
+
+static gboolean _source_cb(gpointer userdata)
+{
+    return FALSE;
+}
+
+static void _wheel_cb(void* userdata)
+{
+}
+
+static void _destroy_notify(gpointer userdata)
+{
+    delete (struct timeout_data*)userdata;
+}
+
+static double bench_gsource(int count, int rounds)
+{
+    GMainContext* ctx = g_main_context_new();
+    std::vector<guint> ids(count);
+    gint64 start = g_get_monotonic_time();
+
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            GSource* source = g_timeout_source_new_seconds(60 + i);
+
+            g_source_set_callback(source, _source_cb, new timeout_data, _destroy_notify);
+            ids[i] = g_source_attach(source, ctx);
+            g_source_unref(source);
+        }
+
+        for (int i = 0; i < count; i++) {
+            GSource* source = g_main_context_find_source_by_id(ctx, ids[i]);
+            if (source)
+                g_source_destroy(source);
+        }
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+    g_main_context_unref(ctx);
+
+    return (double)elapsed * 1000 / ((double)count * rounds);
+}
+
+static double bench_wheel(int count, int rounds)
+{
+    AlertsTimerWheel wheel(0);
+    std::vector<AlertsTimerWheel::TimerId> ids(count);
+    gint64 start = g_get_monotonic_time();
+
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++)
+            ids[i] = wheel.add(60 + i, _wheel_cb, new timeout_data, _destroy_notify);
+
+        for (int i = 0; i < count; i++)
+            wheel.remove(ids[i]);
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    return (double)elapsed * 1000 / ((double)count * rounds);
+}
+
+static double bench_wheel_fire(int count, int rounds)
+{
+    AlertsTimerWheel wheel(0);
+    std::vector<AlertsTimerWheel::Expired> expired;
+    uint64_t now = 0;
+    gint64 start = g_get_monotonic_time();
+
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++)
+            wheel.add(now + 1 + (i % 86400), _wheel_cb, nullptr);
+
+        /* wakeup only for the due slots */
+        uint64_t tick;
+        while (wheel.nextExpiry(&tick)) {
+            now = tick;
+            expired.clear();
+            wheel.collect(now, expired);
+        }
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    return (double)elapsed * 1000 / ((double)count * rounds);
+}
+
+int main(int argc, char* argv[])
+{
+    int count = DEFAULT_COUNT;
+    int rounds = DEFAULT_ROUNDS;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+    if (argc > 2)
+        rounds = atoi(argv[2]);
+
+    if (count <= 0 || rounds <= 0) {
+        printf("usage: %s [count] [rounds]\n", argv[0]);
+        return -1;
+    }
+
+    printf("timers: %d, rounds: %d\n", count, rounds);
+    printf("GSource arm+cancel: %8.1f ns/op\n", bench_gsource(count, rounds));
+    printf("Wheel   arm+cancel: %8.1f ns/op\n", bench_wheel(count, rounds));
+    printf("Wheel   arm+fire  : %8.1f ns/op\n", bench_wheel_fire(count, rounds));
+
+    return 0;
+}
@@ -1,10 +1,23 @@
 
 #include <glib.h>
 #include <json/json.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <thread>
+
 #include "alerts_agent.hh"
+#include "alerts_clock.hh"
+#include "alerts_command_queue.hh"
+#include "alerts_directive_parser.hh"
+#include "alerts_time_parser.hh"
+#include "alerts_timezone.hh"
 #include "alerts_manager.hh"
+#include "alerts_timer_service.hh"
+#include "alerts_timer_wheel.hh"
+#include "alerts_token_index.hh"
 
 #define REPEAT_EVERY_DAY       \
     "\"repeat\" : {"           \
@@ -299,9 +312,13 @@ static void test_case2(void)
     "  \"token\" : \"token-timer\""                   \
     "}"
 
+/* 2021-05-12T05:25:35Z (virtual time of the ignore tests) */
+#define IGNORE_BASE_MSEC 1620797135000ULL
+
 static void test_ignore1(void)
 {
-    AlertsManager manager;
+    AlertsVirtualClock clock(IGNORE_BASE_MSEC);
+    AlertsManager manager(&clock);
     const AlertItem* item;
     Json::Value root;
     Json::Reader reader;
@@ -310,7 +327,7 @@ static void test_ignore1(void)
     struct tm now_tm;
     time_t now;
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 3;
 
     localtime_r(&now, &now_tm);
@@ -347,7 +364,8 @@ static void test_ignore1(void)
 
 static void test_ignore2(void)
 {
-    AlertsManager manager;
+    AlertsVirtualClock clock(IGNORE_BASE_MSEC);
+    AlertsManager manager(&clock);
     const AlertItem* item;
     Json::Value root;
     Json::Reader reader;
@@ -356,7 +374,7 @@ static void test_ignore2(void)
     struct tm now_tm;
     time_t now;
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 3;
 
     localtime_r(&now, &now_tm);
@@ -393,7 +411,8 @@ static void test_ignore2(void)
 
 static void test_ignore3(void)
 {
-    AlertsManager manager;
+    AlertsVirtualClock clock(IGNORE_BASE_MSEC);
+    AlertsManager manager(&clock);
     const AlertItem* item;
     Json::Value root;
     Json::Reader reader;
@@ -404,7 +423,7 @@ static void test_ignore3(void)
     struct tm now_tm;
     time_t now;
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 3;
 
     localtime_r(&now, &now_tm);
@@ -413,7 +432,7 @@ static void test_ignore3(void)
     snprintf(ymdhms_buf_3secs, sizeof(ymdhms_buf_3secs), "%04d-%02d-%02dT%s",
         now_tm.tm_year + 1900, now_tm.tm_mon + 1, now_tm.tm_mday, hms_buf_3secs);
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 5;
 
     localtime_r(&now, &now_tm);
@@ -445,8 +464,8 @@ static void test_ignore3(void)
     /* remove timer */
     g_assert(manager.removeItem(item->token) == true);
 
-    /* sleep 1 secs to test relative time calculation */
-    sleep(1);
+    /* 1 secs later to test relative time calculation */
+    clock.advance(1000);
 
     /* add timer with same time (4secs after) */
     g_assert(reader.parse(DIR_TIMER, root) == true);
@@ -480,7 +499,8 @@ static void test_ignore3(void)
 
 static void test_ignore4(void)
 {
-    AlertsManager manager;
+    AlertsVirtualClock clock(IGNORE_BASE_MSEC);
+    AlertsManager manager(&clock);
     const AlertItem* item;
     Json::Value root;
     Json::Reader reader;
@@ -489,7 +509,7 @@ static void test_ignore4(void)
     struct tm now_tm;
     time_t now;
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 3;
 
     localtime_r(&now, &now_tm);
@@ -536,7 +556,8 @@ static void test_ignore4(void)
 
 static void test_ignore5(void)
 {
-    AlertsManager manager;
+    AlertsVirtualClock clock(IGNORE_BASE_MSEC);
+    AlertsManager manager(&clock);
     const AlertItem* item;
     Json::Value root;
     Json::Reader reader;
@@ -545,7 +566,7 @@ static void test_ignore5(void)
     struct tm now_tm;
     time_t now;
 
-    now = time(NULL);
+    now = clock.realtimeMsec() / 1000;
     now += 3;
 
     localtime_r(&now, &now_tm);
@@ -585,6 +606,1490 @@ static void test_ignore5(void)
     g_assert(item->is_ignored == false);
 }
 
+static void test_ignore6(void)
+{
+    AlertsVirtualClock clock(IGNORE_BASE_MSEC);
+    AlertsManager manager(&clock);
+    const AlertItem* item;
+    Json::Value root;
+    Json::Reader reader;
+    char hms_buf[32];
+    char ymdhms_buf[64];
+    struct tm now_tm;
+    time_t now;
+
+    now = clock.realtimeMsec() / 1000;
+    now += 3;
+
+    localtime_r(&now, &now_tm);
+    snprintf(hms_buf, sizeof(hms_buf), "%02d:%02d:%02d", now_tm.tm_hour,
+        now_tm.tm_min, now_tm.tm_sec);
+    snprintf(ymdhms_buf, sizeof(ymdhms_buf), "%04d-%02d-%02dT%s",
+        now_tm.tm_year + 1900, now_tm.tm_mon + 1, now_tm.tm_mday, hms_buf);
+
+    /* add timer */
+    g_assert(reader.parse(DIR_TIMER, root) == true);
+    root["scheduledTime"] = ymdhms_buf;
+    g_assert(manager.add(root) == true);
+
+    /* add everyday repeat alarm with same time */
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    root["scheduledTime"] = hms_buf;
+    g_assert(manager.add(root) == true);
+
+    item = manager.findItem("token-timer");
+    g_assert(item != NULL);
+    g_assert(item->is_ignored == true);
+
+    /* remove the alarm before firing: the timer is no longer ignored */
+    g_assert(manager.removeItem("dir1-everyday") == true);
+
+    item = manager.findItem("token-timer");
+    g_assert(item != NULL);
+    g_assert(item->is_activated == true);
+    g_assert(item->is_ignored == false);
+}
+
+static int wheel_fired;
+
+static void _wheel_cb(void* userdata)
+{
+    wheel_fired += GPOINTER_TO_INT(userdata);
+}
+
+static void test_duplication_index(void)
+{
+    AlertsManager manager;
+
+    /* add Weekday(Mon~Fri) repeat */
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+
+    /* reject: add Fri repeat */
+    g_assert(manager.add(DIR1_FRIDAY_REPEAT) == false);
+
+    /* removed item should be dropped from the duplication index */
+    g_assert(manager.removeItem("dir1-weekday") == true);
+    g_assert(manager.add(DIR1_FRIDAY_REPEAT) == true);
+
+    /* reset() should clear the duplication index */
+    manager.reset();
+    g_assert(manager.add(DIR1_FRIDAY_REPEAT) == true);
+}
+
+static void test_transaction(void)
+{
+    AlertsManager manager;
+    AlertsTransaction txn;
+    Json::Value item;
+    Json::Reader reader;
+
+    g_assert(manager.add(DIR1_WEEKEND) == true);
+    uint64_t version = manager.getVersion();
+
+    /* duplicated in the batch: nothing is applied */
+    g_assert(reader.parse(DIR1_WEEKDAY, item) == true);
+    txn.add(item);
+    g_assert(reader.parse(DIR1_FRIDAY_REPEAT, item) == true);
+    txn.add(item);
+    txn.remove("dir1-weekend");
+    txn.remove("dir1-weekend");
+    txn.remove("unknown");
+    txn.snooze("dir1-weekday", 60);
+    g_assert(txn.size() == 6);
+
+    g_assert(manager.commit(txn) == false);
+
+    const std::vector<AlertsTransaction::Entry>& entries = txn.getEntries();
+    g_assert(entries[0].status == AlertsTransaction::STATUS_ABORTED);
+    g_assert(entries[1].status == AlertsTransaction::STATUS_DUPLICATED);
+    g_assert(entries[2].status == AlertsTransaction::STATUS_ABORTED);
+    g_assert(entries[3].status == AlertsTransaction::STATUS_NOT_FOUND);
+    g_assert(entries[4].status == AlertsTransaction::STATUS_NOT_FOUND);
+    g_assert(entries[5].status == AlertsTransaction::STATUS_ABORTED);
+
+    g_assert(manager.getVersion() == version);
+    g_assert(manager.findItem("dir1-weekday") == NULL);
+    g_assert(manager.findItem("dir1-weekend") != NULL);
+    g_assert(manager.getAlertCount() == 1);
+
+    /* unknown tokens of the removes don't abort the batch */
+    AlertsTransaction applied;
+    g_assert(reader.parse(DIR1_WEEKDAY, item) == true);
+    applied.add(item);
+    applied.remove("dir1-weekend");
+    applied.remove("dir1-weekend");
+    applied.remove("unknown");
+    applied.snooze("dir1-weekday", 60);
+
+    g_assert(manager.commit(applied) == false);
+    g_assert(applied.getEntries()[0].status == AlertsTransaction::STATUS_OK);
+    g_assert(applied.getEntries()[4].status == AlertsTransaction::STATUS_OK);
+
+    /* one entry per listed token (DeleteAlerts) */
+    g_assert(applied.getTokens(AlertsTransaction::OP_REMOVE, true).size() == 1);
+    g_assert(applied.getTokens(AlertsTransaction::OP_REMOVE, false).size() == 2);
+
+    AlertItem* alert = manager.findItem("dir1-weekday");
+    g_assert(alert != NULL);
+    g_assert(alert->snooze_secs == 60);
+    g_assert(alert->timer_src != 0);
+    g_assert(manager.findItem("dir1-weekend") == NULL);
+    g_assert(manager.getAlertCount() == 1);
+
+    /* the same token twice, no token */
+    AlertsTransaction invalid;
+    g_assert(reader.parse(DIR1_WEEKEND, item) == true);
+    invalid.add(item);
+    invalid.add(item);
+    item.removeMember("token");
+    invalid.add(item);
+
+    g_assert(manager.commit(invalid) == false);
+    g_assert(invalid.getEntries()[0].status == AlertsTransaction::STATUS_ABORTED);
+    g_assert(invalid.getEntries()[1].status == AlertsTransaction::STATUS_FAILED);
+    g_assert(invalid.getEntries()[2].status == AlertsTransaction::STATUS_FAILED);
+    g_assert(manager.getAlertCount() == 1);
+
+    /* capacity for the net adds */
+    g_assert(manager.setCapacity(2, 3) == true);
+
+    AlertsTransaction full;
+    g_assert(reader.parse(DIR1_WEEKEND, item) == true);
+    full.add(item);
+    g_assert(reader.parse(DIR1_EVERYDAY, item) == true);
+    full.add(item);
+
+    g_assert(manager.commit(full) == false);
+    g_assert(full.getEntries()[0].status == AlertsTransaction::STATUS_ABORTED);
+    g_assert(full.getEntries()[1].status == AlertsTransaction::STATUS_FULL);
+    g_assert(manager.getAlertCount() == 1);
+
+    AlertsTransaction replace;
+    replace.remove("dir1-weekday");
+    g_assert(reader.parse(DIR1_WEEKEND, item) == true);
+    replace.add(item);
+    g_assert(reader.parse(DIR1_EVERYDAY, item) == true);
+    replace.add(item);
+
+    g_assert(manager.commit(replace) == true);
+    g_assert(manager.findItem("dir1-weekday") == NULL);
+    g_assert(manager.getAlertCount() == 2);
+}
+
+static void test_snapshot(void)
+{
+    AlertsManager manager;
+    AlertsManager restored;
+    AlertsManager deactivated;
+    AlertsManager corrupted;
+    const char* path = RUNPATH "/test_alarm.snapshot";
+
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    g_assert(manager.add(DIR1_WEEKEND) == true);
+    g_assert(manager.saveSnapshot(path) == true);
+
+    g_assert(restored.loadSnapshot(path) == true);
+    g_assert(restored.getAlertCount() == 2);
+
+    AlertItem* item = restored.findItem("dir1-weekday");
+    AlertItem* origin = manager.findItem("dir1-weekday");
+    g_assert(item != NULL);
+    g_assert(item->payload->json_loaded == false);
+    g_assert(item->is_repeat == true);
+    g_assert(item->wday_bitset == origin->wday_bitset);
+    g_assert(item->hms_local_secs == origin->hms_local_secs);
+
+    /* original JSON is parsed on demand */
+    g_assert(restored.getAlertList() == manager.getAlertList());
+    g_assert(item->payload->json_loaded == true);
+
+    /* deactivate and remove don't parse the JSON */
+    AlertsManager lazy;
+    g_assert(lazy.loadSnapshot(path) == true);
+    item = lazy.findItem("dir1-weekday");
+    lazy.deactivate(item);
+    g_assert(item->payload->json_loaded == false);
+    g_assert(lazy.removeItem("dir1-weekend") == true);
+    g_assert(item->payload->json_loaded == false);
+    g_assert(lazy.getAlertList()[0]["activation"] == false);
+
+    /* serialized again only when the modified JSON is read */
+    manager.deactivate(origin);
+    g_assert(origin->payload->json_dirty == true);
+
+    /* snooze doesn't change the activation of the directive */
+    manager.snooze(origin, 60);
+    g_assert(origin->is_activated == true);
+    g_assert(manager.saveSnapshot(path) == true);
+    g_assert(origin->payload->json_dirty == false);
+    g_assert(deactivated.loadSnapshot(path) == true);
+    g_assert(deactivated.findItem("dir1-weekday")->payload->activation == false);
+
+    /* the snooze is restored (activated until the snooze is done) */
+    g_assert(deactivated.findItem("dir1-weekday")->snooze_secs > 0);
+    g_assert(deactivated.findItem("dir1-weekday")->is_activated == true);
+
+    /* broken checksum */
+    FILE* fp = fopen(path, "r+");
+    g_assert(fp != NULL);
+    fseek(fp, -1, SEEK_END);
+    fputc('x', fp);
+    fclose(fp);
+
+    g_assert(corrupted.loadSnapshot(path) == false);
+    g_assert(corrupted.getAlertCount() == 0);
+
+    /* out of range type (valid checksum) */
+    AlertsSnapshotWriter writer;
+    AlertsSnapshotRecord record;
+    std::string strings[SNAPSHOT_FIELD_MAX];
+
+    memset(&record, 0, sizeof(record));
+    record.type = ALERT_TYPE_COUNT;
+    strings[SNAPSHOT_FIELD_TOKEN] = "invalid-type";
+    writer.append(record, strings);
+    g_assert(writer.save(path) == true);
+
+    g_assert(corrupted.loadSnapshot(path) == true);
+    g_assert(corrupted.getAlertCount() == 0);
+
+    unlink(path);
+}
+
+static void remove_journal_files(const std::string& path)
+{
+    unlink(path.c_str());
+    unlink((path + ".journal").c_str());
+    unlink((path + ".journal.old").c_str());
+}
+
+static void test_journal(void)
+{
+    std::string path = RUNPATH "/test_alarm.store";
+
+    remove_journal_files(path);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        g_assert(manager.add(DIR1_WEEKEND) == true);
+        manager.deactivate(manager.findItem("dir1-weekday"));
+        g_assert(manager.removeItem("dir1-weekend") == true);
+        manager.syncJournal();
+    }
+
+    /* restore from the journal only (no snapshot) */
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 1);
+        g_assert(manager.findItem("dir1-weekday") != NULL);
+        g_assert(manager.findItem("dir1-weekday")->is_activated == false);
+
+        /* trigger the background compaction (new snapshot) */
+        unlink(path.c_str());
+        for (int i = 0; i < JOURNAL_COMPACTION_THRESHOLD; i++) {
+            g_assert(manager.add(DIR1_WEEKEND) == true);
+            g_assert(manager.removeItem("dir1-weekend") == true);
+        }
+        manager.syncJournal();
+        g_assert(access(path.c_str(), F_OK) == 0);
+    }
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 1);
+        g_assert(manager.findItem("dir1-weekday") != NULL);
+
+        /* reset close to the compaction threshold */
+        Json::Value root;
+        Json::Reader reader;
+        g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+        g_assert(manager.setCapacity(JOURNAL_COMPACTION_THRESHOLD, JOURNAL_COMPACTION_THRESHOLD + 2) == true);
+        for (int i = 0; i < JOURNAL_COMPACTION_THRESHOLD - 8; i++) {
+            char buf[16];
+
+            snprintf(buf, sizeof(buf), "01:%02d:%02d", i / 60, i % 60);
+            root["token"] = "reset-" + std::to_string(i);
+            root["scheduledTime"] = buf;
+            g_assert(manager.add(root) == true);
+        }
+
+        manager.reset();
+        g_assert(manager.getAlertCount() == 0);
+        manager.syncJournal();
+    }
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 0);
+    }
+
+    /* the snooze is kept by the compaction (the journal is dropped) */
+    remove_journal_files(path);
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        manager.deactivate(manager.findItem("dir1-weekday"));
+        manager.snooze(manager.findItem("dir1-weekday"), 600);
+        manager.scheduling();
+
+        for (int i = 0; i < JOURNAL_COMPACTION_THRESHOLD / 2; i++) {
+            g_assert(manager.add(DIR1_WEEKEND) == true);
+            g_assert(manager.removeItem("dir1-weekend") == true);
+        }
+        manager.syncJournal();
+    }
+
+    g_assert(access(path.c_str(), F_OK) == 0);
+    g_assert(access((path + ".journal.old").c_str(), F_OK) != 0);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        AlertItem* item = manager.findItem("dir1-weekday");
+        g_assert(item != NULL);
+        /* the deadline is rounded up to the second */
+        g_assert(item->snooze_secs > 0 && item->snooze_secs <= 601);
+        g_assert(item->is_activated == true);
+        g_assert(item->payload->activation == false);
+        g_assert(item->timer_src != 0);
+    }
+
+    /* expired snooze */
+    {
+        AlertsVirtualClock clock((uint64_t)(time(NULL) + 700) * 1000);
+        AlertsManager manager(&clock);
+
+        g_assert(manager.loadSnapshot(path) == true);
+        g_assert(manager.findItem("dir1-weekday")->snooze_secs == 0);
+        g_assert(manager.findItem("dir1-weekday")->is_activated == false);
+    }
+
+    /* the snapshot can't be saved (directory): all the records are replayed */
+    remove_journal_files(path);
+    g_assert(mkdir(path.c_str(), 0700) == 0);
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        for (int i = 0; i < JOURNAL_COMPACTION_THRESHOLD * 5; i++) {
+            g_assert(manager.add(DIR1_WEEKEND) == true);
+            g_assert(manager.removeItem("dir1-weekend") == true);
+        }
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        manager.syncJournal();
+    }
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 1);
+        g_assert(manager.findItem("dir1-weekday") != NULL);
+
+        /* over the limit of the rotated journal: the appends are refused */
+        Json::Value root;
+        Json::Reader reader;
+        g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+        root["padding"] = std::string(64 * 1024, 'x');
+        for (int i = 0; i < 100; i++) {
+            g_assert(manager.add(root) == true);
+            g_assert(manager.removeItem("dir1-everyday") == true);
+        }
+        manager.syncJournal();
+
+        struct stat st;
+        g_assert(stat((path + ".journal.old").c_str(), &st) == 0);
+        g_assert(st.st_size < JOURNAL_ROTATED_LIMIT_BYTES + JOURNAL_COMPACTION_BYTES * 2);
+
+        /* kept by the snapshot once it can be saved */
+        g_assert(manager.add(DIR1_WEEKEND) == true);
+        manager.syncJournal();
+        g_assert(rmdir(path.c_str()) == 0);
+        manager.deactivate(manager.findItem("dir1-weekend"));
+    }
+
+    g_assert(access((path + ".journal.old").c_str(), F_OK) != 0);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 2);
+        g_assert(manager.findItem("dir1-weekday") != NULL);
+        g_assert(manager.findItem("dir1-weekend")->is_activated == false);
+    }
+
+    /* the records before the garbage of a huge journal are replayed */
+    remove_journal_files(path);
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        manager.syncJournal();
+    }
+
+    FILE* fp = fopen((path + ".journal").c_str(), "r+");
+    g_assert(fp != NULL);
+    g_assert(fseek(fp, 5 * 1024 * 1024, SEEK_END) == 0);
+    fputc(0, fp);
+    fclose(fp);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.findItem("dir1-weekday") != NULL);
+    }
+
+    /* crash after the snapshot is saved, before the rotated journal is
+     * removed: the records already in the snapshot are skipped */
+    remove_journal_files(path);
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        manager.reset();
+        g_assert(manager.add(DIR1_WEEKEND) == true);
+        manager.syncJournal();
+    }
+
+    std::string stale_path = path + ".stale";
+    unlink(stale_path.c_str());
+    g_assert(link((path + ".journal").c_str(), stale_path.c_str()) == 0);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 1);
+        g_assert(manager.removeItem("dir1-weekend") == true);
+
+        /* compaction: the removal is only in the snapshot */
+        for (int i = 0; i < JOURNAL_COMPACTION_THRESHOLD / 2 + 1; i++) {
+            g_assert(manager.add(DIR1_EVERYDAY) == true);
+            g_assert(manager.removeItem("dir1-everyday") == true);
+        }
+        manager.syncJournal();
+    }
+
+    g_assert(access((path + ".journal.old").c_str(), F_OK) != 0);
+    g_assert(rename(stale_path.c_str(), (path + ".journal.old").c_str()) == 0);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 0);
+
+        /* the seq continues after the restart */
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        manager.syncJournal();
+    }
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.openJournal(path) == true);
+        g_assert(manager.getAlertCount() == 1);
+        g_assert(manager.findItem("dir1-weekday") != NULL);
+    }
+
+    remove_journal_files(path);
+}
+
+struct TokenItem {
+    std::string token;
+};
+
+static void test_token_index(void)
+{
+    AlertsTokenIndex<TokenItem> index;
+    std::vector<TokenItem> items(200);
+
+    for (size_t i = 0; i < items.size(); i++) {
+        items[i].token = "token-" + std::to_string(i);
+        g_assert(index.insert(&items[i]) == true);
+    }
+
+    g_assert(index.size() == 200);
+    g_assert(index.insert(&items[7]) == false);
+    g_assert(index.find("token-7") == &items[7]);
+    g_assert(index.find("token-7", 5) == NULL);
+    g_assert(index.find("unknown") == NULL);
+
+    /* the remaining entries are found after the backward shift */
+    for (size_t i = 0; i < items.size(); i += 2)
+        g_assert(index.erase(items[i].token) == &items[i]);
+
+    g_assert(index.size() == 100);
+    g_assert(index.erase("token-0", 7) == NULL);
+
+    for (size_t i = 0; i < items.size(); i++)
+        g_assert(index.find(items[i].token) == ((i % 2) ? &items[i] : NULL));
+
+    /* lookup from a C string does not throw on a miss */
+    AlertsManager manager;
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    g_assert(manager.findItem("dir1-weekday") != NULL);
+    g_assert(manager.findItem("dir1-weekend") == NULL);
+    g_assert(manager.findItem((const char*)NULL) == NULL);
+}
+
+static void test_handle(void)
+{
+    AlertsManager manager;
+
+    g_assert(manager.getItem(0) == NULL);
+
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    AlertItem* item = manager.findItem("dir1-weekday");
+    AlertHandle handle = item->handle;
+    g_assert(handle != 0);
+    g_assert(manager.getItem(handle) == item);
+
+    /* stale handle after the removal */
+    g_assert(manager.removeItem("dir1-weekday") == true);
+    g_assert(manager.getItem(handle) == NULL);
+
+    /* the slot is reused with a new generation */
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    item = manager.findItem("dir1-weekday");
+    g_assert(item->handle != handle);
+    g_assert(manager.getItem(item->handle) == item);
+    g_assert(manager.getItem(handle) == NULL);
+
+    handle = item->handle;
+    manager.reset();
+    g_assert(manager.getItem(handle) == NULL);
+}
+
+static void test_pool(void)
+{
+    AlertsPool<AlertItem> pool(2);
+
+    void* first = pool.allocate();
+    void* second = pool.allocate();
+    void* overflow = pool.allocate();
+
+    AlertsPoolStats stats = pool.getStats();
+    g_assert(stats.capacity == 2);
+    g_assert(stats.used == 3);
+    g_assert(stats.overflow == 1);
+
+    pool.release(overflow);
+    pool.release(second);
+    g_assert(pool.allocate() == second);
+    pool.release(second);
+    pool.release(first);
+
+    stats = pool.getStats();
+    g_assert(stats.used == 0);
+    g_assert(stats.peak == 3);
+
+    /* grown by another block (no overflow up to the new capacity) */
+    pool.reserve(4);
+    void* records[4];
+    for (int i = 0; i < 4; i++)
+        records[i] = pool.allocate();
+
+    stats = pool.getStats();
+    g_assert(stats.capacity == 4);
+    g_assert(stats.overflow == 1);
+    for (int i = 0; i < 4; i++)
+        pool.release(records[i]);
+
+    /* nodes of the node-based containers */
+    alerts_reserve_nodes(8);
+    AlertsPoolAllocator<int> allocator;
+    int* node = allocator.allocate(1);
+    g_assert(AlertsPoolAllocator<int>::getStats().capacity >= 8);
+    g_assert(AlertsPoolAllocator<int>::getStats().used == 1);
+    allocator.deallocate(node, 1);
+    g_assert(allocator.allocate(1) == node);
+    allocator.deallocate(node, 1);
+    g_assert(AlertsPoolAllocator<int>::getStats().overflow == 0);
+
+    std::set<int, std::less<int>, AlertsPoolAllocator<int>> nodes;
+    for (int i = 0; i < 8; i++)
+        nodes.insert(i);
+    g_assert(nodes.size() == 8 && *nodes.begin() == 0);
+    nodes.clear();
+
+    /* alert items and the armed timers come from the shared pools (grown by setCapacity) */
+    AlertsPoolStats items = AlertsManager::getItemPoolStats();
+    AlertsPoolStats timeouts = AlertsManager::getTimeoutPoolStats();
+    g_assert(items.capacity >= MAX_ALERTS);
+    g_assert(timeouts.capacity >= MAX_ALERT_TIMERS);
+
+    {
+        AlertsManager manager;
+
+        g_assert(manager.add(DIR1_WEEKDAY) == true);
+        g_assert(AlertsManager::getItemPoolStats().used == items.used + 1);
+
+        timeouts = AlertsManager::getTimeoutPoolStats();
+        AlertTimerId src = manager.addTimeout(100, "pool", true);
+        g_assert(AlertsManager::getTimeoutPoolStats().used == timeouts.used + 1);
+        manager.removeTimeout(src);
+        g_assert(AlertsManager::getTimeoutPoolStats().used == timeouts.used);
+    }
+
+    g_assert(AlertsManager::getItemPoolStats().used == items.used);
+    g_assert(AlertsManager::getItemPoolStats().overflow == items.overflow);
+}
+
+static void count_command(void* userdata)
+{
+    (*(int*)userdata)++;
+}
+
+static void test_command_queue(void)
+{
+    AlertsCommandQueue queue;
+    std::vector<std::thread> producers;
+    std::vector<AlertsCommandQueue::Command> commands(400);
+    int executed = 0;
+
+    for (auto& command : commands) {
+        command.func = count_command;
+        command.userdata = &executed;
+    }
+
+    /* a queued command is not queued again */
+    g_assert(queue.post(&commands[0]) == true);
+    g_assert(queue.post(&commands[0]) == false);
+    g_assert(queue.drain() == 1);
+    g_assert(executed == 1);
+
+    for (int t = 0; t < 4; t++) {
+        producers.push_back(std::thread([&, t] {
+            for (int i = 0; i < 100; i++)
+                queue.post(&commands[t * 100 + i]);
+        }));
+    }
+
+    size_t drained = 0;
+    while (drained < commands.size()) {
+        drained += queue.drain();
+        g_usleep(100);
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+
+    g_assert(drained == commands.size());
+    g_assert(executed == 401);
+}
+
+static void test_version(void)
+{
+    AlertsManager manager;
+    uint64_t version = manager.getVersion();
+
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    g_assert(manager.getVersion() > version);
+
+    /* read-only operations keep the version (context cache) */
+    version = manager.getVersion();
+    manager.getAlertList(true);
+    manager.scheduling();
+    g_assert(manager.getVersion() == version);
+
+    manager.deactivate(manager.findItem("dir1-weekday"));
+    g_assert(manager.getVersion() > version);
+
+    version = manager.getVersion();
+    g_assert(manager.removeItem("dir1-weekday") == true);
+    g_assert(manager.getVersion() > version);
+
+    version = manager.getVersion();
+    g_assert(manager.removeItem("dir1-weekday") == false);
+    g_assert(manager.getVersion() == version);
+}
+
+static void test_context_projection(void)
+{
+    AlertsManager manager;
+    Json::FastWriter writer;
+
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    g_assert(manager.add(DIR1_EVERYDAY) == true);
+    g_assert(manager.add("{"
+                         "    \"activation\" : true,"
+                         "    \"alertType\" : \"ALARM\","
+                         "    \"alarmResourceType\" : \"MUSIC\","
+                         "    \"assets\" : [ { \"token\" : \"asset\", \"payload\" : \"...\" } ],"
+                         "    \"playServiceId\" : \"ps\","
+                         "    \"scheduledTime\" : \"2030-04-30T16:07:05\","
+                         "    \"token\" : \"dir1-assets\""
+                         "}")
+        == true);
+    g_assert(manager.add("{"
+                         "    \"activation\" : true,"
+                         "    \"alertType\" : \"ALARM\","
+                         "    \"playServiceId\" : \"ps\","
+                         "    \"repeat\" : {"
+                         "        \"type\" : \"WEEKLY\","
+                         "        \"daysOfWeek\" : [ \"MON\", \"TUE\", \"WED\", \"THU\", \"FRI\", \"SAT\", \"SUN\" ]"
+                         "    },"
+                         "    \"scheduledTime\" : \"07:00:00\","
+                         "    \"token\" : \"dir1-weekly-all\""
+                         "}")
+        == true);
+
+    Json::Value full = manager.getAlertList(true);
+    Json::Value slim = manager.getContextAlertList();
+
+    g_assert(slim.size() == full.size());
+    g_assert(writer.write(slim).size() < writer.write(full).size());
+
+    for (Json::ArrayIndex i = 0; i < slim.size(); i++) {
+        g_assert(slim[i].isMember("assets") == false);
+        g_assert(slim[i].isMember("playServiceId") == full[i].isMember("playServiceId"));
+        g_assert(slim[i].isMember("alarmResourceType") == full[i].isMember("alarmResourceType"));
+        g_assert(slim[i]["token"] == full[i]["token"]);
+        g_assert(slim[i]["alertType"] == full[i]["alertType"]);
+        g_assert(slim[i]["scheduledTime"] == full[i]["scheduledTime"]);
+        g_assert(slim[i]["activation"] == full[i]["activation"]);
+        g_assert(slim[i]["repeat"] == full[i]["repeat"]);
+    }
+
+    /* WEEKLY of all days is not projected as DAILY */
+    g_assert(slim[3]["repeat"]["type"] == "WEEKLY");
+    g_assert(slim[3]["repeat"]["daysOfWeek"].size() == 7);
+
+    g_assert(slim[2]["alarmResourceType"] == "MUSIC");
+    g_assert(slim[2]["playServiceId"] == "ps");
+
+    /* the optional fields are not written when missing */
+    g_assert(slim[0].isMember("playServiceId") == false);
+    g_assert(slim[0].isMember("alarmResourceType") == false);
+
+    /* snooze does not change the activation of the directive */
+    manager.deactivate(manager.findItem("dir1-weekday"));
+    manager.snooze(manager.findItem("dir1-weekday"), 60);
+    g_assert(manager.getContextAlertList()[0]["activation"] == false);
+}
+
+static void test_directive_parser(void)
+{
+    const char* set_alert = "{"
+                            "  \"playServiceId\" : \"ps\","
+                            "  \"token\" : \"tok\\u0041\\n\","
+                            "  \"alertType\" : \"ALARM\","
+                            "  \"activation\" : true," REPEAT_WEEKEND
+                            "  \"scheduledTime\" : \"15:07:05\","
+                            "  \"assets\" : [ { \"header\" : { \"name\" : \"Play\" } } ],"
+                            "  \"assetRequiredInMilliseconds\" : 5500,"
+                            "  \"playStackControl\" : { \"type\" : \"PUSH\" },"
+                            "  \"unknown\" : [ 1, -2.5e3, null, false, { } ]"
+                            "}";
+    AlertsSetAlertDirective alert;
+
+    g_assert(AlertsDirectiveParser::parseSetAlert(set_alert, strlen(set_alert), &alert) == true);
+    g_assert(alert.raw == set_alert);
+    g_assert(alert.ps_id == "ps");
+    g_assert(alert.token == "tokA\n");
+    g_assert(alert.type == "ALARM");
+    g_assert(alert.scheduled_time == "15:07:05");
+    g_assert(alert.has_activation && alert.activation);
+    g_assert(alert.has_assets);
+    g_assert(alert.is_repeat);
+    g_assert(alert.wday_bitset == DAY_WEEKEND);
+    g_assert(alert.wday_count == 2);
+    g_assert(alert.has_asset_required && alert.asset_required_msec == 5500);
+    g_assert(alert.has_min_duration == false);
+    g_assert(std::string(alert.playstack_control, alert.playstack_control_length) == "{ \"type\" : \"PUSH\" }");
+
+    /* the same item as the JSON path */
+    AlertsManager manager;
+    AlertItem* item = manager.generateAlert(alert);
+    g_assert(item->payload->json_str == set_alert);
+    g_assert(item->type == ALERT_TYPE_ALARM);
+    g_assert(item->wday_bitset == DAY_WEEKEND);
+    g_assert(item->asset_secs == 5);
+    delete item;
+
+    /* DAILY, missing and empty fields */
+    const char* daily = "{ \"repeat\" : { \"type\" : \"DAILY\" }, \"activation\" : null, \"assets\" : [] }";
+    g_assert(AlertsDirectiveParser::parseSetAlert(daily, strlen(daily), &alert) == true);
+    g_assert(alert.wday_bitset == DAY_ALL && alert.wday_count == 7);
+    g_assert(alert.has_activation == false);
+    g_assert(alert.has_assets == false);
+    g_assert(alert.token.empty() && alert.playstack_control == nullptr);
+
+    /* invalid JSON, unknown day name and number out of the int64 range */
+    const char* invalid[] = {
+        "",
+        "[]",
+        "{ \"token\" : \"abc }",
+        "{ \"token\" : \"abc\", }",
+        "{ \"token\" : tru }",
+        "{ \"token\" : \"abc\" } garbage",
+        "{ \"repeat\" : { \"type\" : \"WEEKLY\", \"daysOfWeek\" : [ \"MONDAY\" ] } }",
+        "{ \"assetRequiredInMilliseconds\" : 1e300 }",
+        "{ \"assetRequiredInMilliseconds\" : -9.3e18 }",
+        "{ \"assetRequiredInMilliseconds\" : 99999999999999999999 }",
+    };
+    for (auto const& message : invalid)
+        g_assert(AlertsDirectiveParser::parseSetAlert(message, strlen(message), &alert) == false);
+
+    const char* delete_alerts = "{ \"playServiceId\" : \"ps\", \"tokens\" : [ \"a\", \"b\" ] }";
+    AlertsDeleteAlertsDirective del;
+    g_assert(AlertsDirectiveParser::parseDeleteAlerts(delete_alerts, strlen(delete_alerts), &del) == true);
+    g_assert(del.ps_id == "ps");
+    g_assert(del.tokens.size() == 2 && del.tokens[1] == "b");
+
+    const char* set_snooze = "{ \"playServiceId\" : \"ps\", \"token\" : \"a\", \"durationInSec\" : 300 }";
+    AlertsSetSnoozeDirective snooze;
+    g_assert(AlertsDirectiveParser::parseSetSnooze(set_snooze, strlen(set_snooze), &snooze) == true);
+    g_assert(snooze.token == "a" && snooze.has_duration && snooze.duration_sec == 300);
+
+    const char* huge_snooze = "{ \"token\" : \"a\", \"durationInSec\" : 1e300 }";
+    g_assert(AlertsDirectiveParser::parseSetSnooze(huge_snooze, strlen(huge_snooze), &snooze) == false);
+
+    /* the largest one in the range */
+    const char* max_snooze = "{ \"token\" : \"a\", \"durationInSec\" : 9223372036854775807 }";
+    g_assert(AlertsDirectiveParser::parseSetSnooze(max_snooze, strlen(max_snooze), &snooze) == true);
+    g_assert(snooze.duration_sec == INT64_MAX);
+
+    const char* delivery = "{ \"playServiceId\" : \"ps\", \"token\" : \"a\", \"assetDetails\" : ["
+                           "  { \"header\" : { \"namespace\" : \"Routine\", \"name\" : \"Start\", \"dialogRequestId\" : \"d1\" },"
+                           "    \"payload\" : { \"actions\" : [ ] } },"
+                           "  { \"header\" : { }, \"payload\" : { \"a\" : 1 } }"
+                           "] }";
+    AlertsDeliveryAlertAssetDirective asset;
+    g_assert(AlertsDirectiveParser::parseDeliveryAlertAsset(delivery, strlen(delivery), &asset) == true);
+    g_assert(asset.asset_details.size() == 2);
+    g_assert(asset.asset_details[0].name_space == "Routine" && asset.asset_details[0].name == "Start");
+    g_assert(asset.asset_details[0].dialog_request_id == "d1");
+    g_assert(std::string(asset.asset_details[0].payload, asset.asset_details[0].payload_length) == "{ \"actions\" : [ ] }");
+    g_assert(asset.asset_details[1].has_header == false);
+    g_assert(asset.asset_details[1].has_payload == true);
+}
+
+#define PARSE_TIME(str) alerts_parse_time(str, sizeof(str) - 1)
+
+/* evaluated at compile time */
+static_assert(PARSE_TIME("07:30:05").valid && !PARSE_TIME("07:30:05").has_date, "hms");
+static_assert(PARSE_TIME("07:30:05.25").msec == 250, "fraction");
+static_assert(PARSE_TIME("2024-02-29T23:59:59.123456789Z").msec == 123, "leap year");
+static_assert(PARSE_TIME("2021-04-30T15:07:05+09:00").offset_secs == 9 * 3600, "offset");
+static_assert(PARSE_TIME("2021-04-30T15:07:05-0530").offset_secs == -(5 * 3600 + 30 * 60), "offset");
+static_assert(!PARSE_TIME("2023-02-29T00:00:00").valid, "not a leap year");
+static_assert(!PARSE_TIME("2021-04-31T00:00:00").valid, "day of month");
+static_assert(!PARSE_TIME("24:00:00").valid, "hour");
+static_assert(!PARSE_TIME("07:30:05Z").valid, "offset without date");
+static_assert(!PARSE_TIME("07:30:05.").valid, "empty fraction");
+static_assert(!PARSE_TIME("2021-04-30T15:07:05 ").valid, "trailing data");
+
+static void test_time_parser(void)
+{
+    const char* invalid[] = { "", "7:30:05", "07:30", "07:3a:05", "2021-4-30T15:07:05",
+        "2021-04-30 15:07:05", "2021-04-30T15:07:05+25:00", "07:30:05.1234567890" };
+
+    for (auto const& str : invalid)
+        g_assert(alerts_parse_time(str, strlen(str)).valid == false);
+
+    std::string str = "2021-04-30T15:07:05.5+09:00";
+    AlertsTime t = alerts_parse_time(str.data(), str.size());
+    g_assert(t.valid && t.has_date && t.has_offset);
+    g_assert(t.year == 2021 && t.month == 4 && t.day == 30);
+    g_assert(t.hour == 15 && t.minute == 7 && t.second == 5 && t.msec == 500);
+
+    /* invalid scheduledTime is not added */
+    AlertsManager manager;
+    Json::Value root;
+    Json::Reader reader;
+
+    g_assert(reader.parse(DIR1_NO_REPEAT_TIME, root) == true);
+    root["scheduledTime"] = "2021-02-30T15:07:05";
+    g_assert(manager.add(root) == false);
+
+    /* repeat alerts only have H:M:S */
+    g_assert(reader.parse(DIR1_WEEKDAY, root) == true);
+    root["scheduledTime"] = "2021-04-30T15:07:05";
+    g_assert(manager.add(root) == false);
+
+    /* the UTC offset is used instead of KST */
+    g_assert(reader.parse(DIR1_NO_REPEAT_TIME, root) == true);
+    root["scheduledTime"] = "2030-04-30T06:07:05Z";
+    g_assert(manager.add(root) == true);
+    g_assert(manager.findItem("dir1-no-repeat")->local_secs == 1903759625);
+}
+
+static void test_timezone(void)
+{
+    AlertsTimezone berlin;
+    AlertsTimezone rule;
+    AlertsLocalTime local;
+
+    if (!berlin.load("Europe/Berlin")) {
+        g_test_skip("no tzdata");
+        return;
+    }
+
+    /* DST starts at 2021-03-28 01:00 UTC */
+    g_assert(berlin.offsetAt(1616893199) == 3600);
+    g_assert(berlin.offsetAt(1616893200) == 7200);
+
+    /* gap: 02:30 local is moved to 03:30 CEST (01:30 UTC) */
+    g_assert(berlin.toUtc(1616898600) == 1616895000);
+
+    /* overlap: 2021-10-31 02:30 local is the earlier one (CEST) */
+    g_assert(berlin.toUtc(1635647400) == 1635640200);
+
+    /* the TZ rule of the footer (2090-07-01 12:00 UTC) */
+    g_assert(berlin.offsetAt(3802593600) == 7200);
+    g_assert(rule.loadRule("CET-1CEST,M3.5.0,M10.5.0/3") == true);
+    g_assert(rule.offsetAt(3802593600) == 7200);
+
+    /* same as libc */
+    const char* saved = getenv("TZ");
+    std::string saved_tz = saved ? saved : "";
+
+    setenv("TZ", "Europe/Berlin", 1);
+    tzset();
+    for (time_t t = 0; t < 2100000000; t += 86400 * 7 + 3607) {
+        struct tm tm;
+
+        localtime_r(&t, &tm);
+        berlin.breakDown(t, &local);
+        g_assert(local.offset_secs == tm.tm_gmtoff);
+        g_assert(local.year == tm.tm_year + 1900 && local.month == tm.tm_mon + 1 && local.day == tm.tm_mday);
+        g_assert(local.hour == tm.tm_hour && local.minute == tm.tm_min && local.wday == tm.tm_wday);
+        g_assert(rule.offsetAt(t) == tm.tm_gmtoff || t < 820454400); /* EU rule since 1996 */
+    }
+
+    if (saved)
+        setenv("TZ", saved_tz.c_str(), 1);
+    else
+        unsetenv("TZ");
+    tzset();
+
+    /* 09:00 of the DST day (2021-03-27 12:00 UTC + 19h) */
+    AlertsManager manager;
+    Json::Value root;
+    Json::Reader reader;
+
+    g_assert(manager.setTimezone("Europe/Berlin") == true);
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    root["scheduledTime"] = "09:00:00";
+    g_assert(manager.addItem(manager.generateAlert(root)) == true);
+    manager.scheduling(1616846400);
+    g_assert(manager.findItem("dir1-everyday")->timeout_secs == 19 * 3600);
+}
+
+static void test_local_day(void)
+{
+    AlertsManager manager;
+    AlertsTimezone berlin;
+    Json::Value root;
+    Json::Reader reader;
+
+    if (!berlin.load("Europe/Berlin")) {
+        g_test_skip("no tzdata");
+        return;
+    }
+
+    g_assert(manager.setTimezone("Europe/Berlin") == true);
+
+    /* SUN/WED/SAT 02:30 (skipped on 2021-03-28) */
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    root["scheduledTime"] = "02:30:00";
+    root["repeat"]["type"] = "WEEKLY";
+    root["repeat"]["daysOfWeek"] = Json::Value(Json::arrayValue);
+    root["repeat"]["daysOfWeek"].append("SUN");
+    root["repeat"]["daysOfWeek"].append("WED");
+    root["repeat"]["daysOfWeek"].append("SAT");
+    g_assert(manager.addItem(manager.generateAlert(root)) == true);
+
+    AlertItem* item = manager.findItem("dir1-everyday");
+    g_assert(item != nullptr && item->wday_bitset == (DAY_SUN | DAY_WED | DAY_SAT));
+
+    /* the cached local days are same as the conversion of every call */
+    for (time_t now = 1609455600; now < 1641013200; now += 3 * 3600 + 17) {
+        time_t local = berlin.toLocal(now);
+        int64_t days = local / 86400;
+        time_t now_hms = local - days * 86400;
+        time_t expected = 0;
+
+        for (int k = 0; k < 8; k++) {
+            if ((item->wday_bitset & (1 << AlertsTimezone::weekday(days + k))) == 0)
+                continue;
+
+            expected = berlin.toUtc((days + k) * 86400 + item->hms_local_secs) - now;
+
+            /* passed (or the earlier one of the DST overlap has passed) */
+            if (k == 0 && (item->hms_local_secs < now_hms || expected < 0))
+                continue;
+
+            break;
+        }
+
+        /* reschedule */
+        manager.activate(item);
+        manager.scheduling(now);
+        g_assert(item->timeout_secs == expected);
+    }
+}
+
+/* completes the fired alarm like the agent and records the local time */
+class SimulationListener : public IAlertsManagerListener {
+public:
+    SimulationListener(AlertsManager* cmanager, AlertsClock* cclock)
+        : manager(cmanager)
+        , clock(cclock)
+    {
+    }
+
+    void onTimeout(const std::string& token) override
+    {
+        AlertsLocalTime local;
+
+        manager->getTimezone().breakDown(clock->realtimeMsec() / 1000, &local);
+        fired.push_back(local);
+
+        manager->done(manager->findItem(token));
+        manager->scheduling();
+    }
+    void onAssetRequireTimeout(const std::string& token) override
+    {
+    }
+    void onDurationTimeout(const std::string& token) override
+    {
+    }
+
+    AlertsManager* manager;
+    AlertsClock* clock;
+    std::vector<AlertsLocalTime> fired;
+};
+
+static void test_virtual_clock(void)
+{
+    /* 2021-01-01T00:00:00+01:00 */
+    AlertsVirtualClock clock(1609455600000ULL);
+    AlertsManager manager(&clock);
+    SimulationListener listener(&manager, &clock);
+    Json::Value root;
+    Json::Reader reader;
+    AlertsTimezone berlin;
+
+    if (!berlin.load("Europe/Berlin")) {
+        g_test_skip("no tzdata");
+        return;
+    }
+
+    g_assert(manager.setTimezone("Europe/Berlin") == true);
+    manager.setListener(&listener);
+
+    /* everyday 07:00:00 for a year (DST changes included) */
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    root["scheduledTime"] = "07:00:00";
+    g_assert(manager.add(root) == true);
+
+    clock.advance(365ULL * 86400 * 1000);
+
+    g_assert(listener.fired.size() == 365);
+    for (auto const& local : listener.fired)
+        g_assert(local.hour == 7 && local.minute == 0 && local.second == 0);
+
+    g_assert(listener.fired[0].month == 1 && listener.fired[0].day == 1);
+    g_assert(listener.fired[364].month == 12 && listener.fired[364].day == 31);
+
+    /* the clock is set to 1 hour later (the alarm is passed) */
+    listener.fired.clear();
+    clock.advance(6 * 3600 * 1000);
+    clock.setRealtime(clock.realtimeMsec() + 3600 * 1000);
+
+    g_assert(listener.fired.size() == 1);
+    g_assert(listener.fired[0].hour == 7 && listener.fired[0].minute == 0);
+}
+
+static void test_clock_step_dispatch(void)
+{
+    /* 2021-01-01T00:00:00+01:00 */
+    AlertsVirtualClock clock(1609455600000ULL);
+    AlertsManager manager(&clock);
+    SimulationListener listener(&manager, &clock);
+    Json::Value root;
+    Json::Reader reader;
+    AlertsTimezone berlin;
+
+    if (!berlin.load("Europe/Berlin")) {
+        g_test_skip("no tzdata");
+        return;
+    }
+
+    g_assert(manager.setTimezone("Europe/Berlin") == true);
+    manager.setListener(&listener);
+
+    /* everyday 07:00:00, one-shot timer at 03:00:00, snooze until 04:00:00 */
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    root["scheduledTime"] = "07:00:00";
+    g_assert(manager.add(root) == true);
+    g_assert(reader.parse(DIR_TIMER, root) == true);
+    root["scheduledTime"] = "2021-01-01T03:00:00";
+    g_assert(manager.add(root) == true);
+    g_assert(manager.add(DIR1_WEEKDAY) == true);
+    manager.snooze(manager.findItem("dir1-weekday"), 4 * 3600);
+    manager.scheduling();
+
+    /* the clock is set 2 days back after the fire, before the dispatch */
+    clock.setSynchronous(false);
+    clock.advance(3 * 3600 * 1000);
+    clock.setRealtime(clock.realtimeMsec() - 2 * 86400 * 1000);
+    g_main_context_iteration(NULL, FALSE);
+    g_assert(listener.fired.size() == 0);
+
+    /* 2020-12-30T04:00:00+01:00: the snooze follows the clock */
+    g_assert(manager.findItem("dir1-weekday")->fire_msec == (int64_t)(1609455600000ULL - 2 * 86400 * 1000 + 4 * 3600 * 1000));
+
+    /* the everyday alarm is recomputed for 2020-12-30 */
+    clock.setSynchronous(true);
+    clock.advance(5 * 3600 * 1000);
+    g_assert(listener.fired.size() == 2);
+    g_assert(listener.fired[0].day == 30 && listener.fired[0].hour == 4);
+    g_assert(listener.fired[1].day == 30 && listener.fired[1].hour == 7);
+}
+
+static void test_capacity(void)
+{
+    /* 2021-01-01T20:00:00+01:00 (after the last alarm of the day) */
+    AlertsVirtualClock clock(1609527600000ULL);
+    AlertsManager manager(&clock);
+    Json::Value root;
+    Json::Reader reader;
+    char buf[16];
+    AlertsTimezone berlin;
+
+    if (!berlin.load("Europe/Berlin")) {
+        g_test_skip("no tzdata");
+        return;
+    }
+
+    g_assert(manager.setTimezone("Europe/Berlin") == true);
+
+    g_assert(manager.getMaxAlarmCount() == MAX_ALARM);
+    g_assert(manager.getMaxAlertCount() == MAX_ALERTS);
+
+    g_assert(manager.setCapacity(0, 10) == false);
+    g_assert(manager.setCapacity(3, 2) == false);
+    g_assert(manager.setCapacity(1, MAX_ALERTS_LIMIT + 1) == false);
+
+    /* 2 alarms + 1 timer */
+    g_assert(manager.setCapacity(2, 3) == true);
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    for (int i = 0; i < 3; i++) {
+        root["token"] = "alarm-" + std::to_string(i);
+        snprintf(buf, sizeof(buf), "0%d:00:00", i + 1);
+        root["scheduledTime"] = buf;
+        g_assert(manager.add(root) == (i < 2));
+    }
+
+    g_assert(manager.add(DIR_TIMER) == true);
+    g_assert(manager.add(DIR_SLEEP) == false);
+
+    /* the new timer replaces the existing one */
+    g_assert(reader.parse(DIR_TIMER, root) == true);
+    root["token"] = "token-timer2";
+    root["scheduledTime"] = "2021-05-12T14:30:00";
+    g_assert(manager.add(root) == true);
+    g_assert(manager.findItem("token-timer") == nullptr);
+    g_assert(manager.getAlertCount() == 3);
+
+    /* SetAlert directive: the same checks of AlertsAgent::parsingSetAlert() */
+    AlertsSetAlertDirective directive;
+    Json::FastWriter writer;
+    std::string message;
+    AlertItem* alert;
+
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    root["token"] = "alarm-2";
+    root["scheduledTime"] = "03:00:00";
+    message = writer.write(root);
+    g_assert(AlertsDirectiveParser::parseSetAlert(message.c_str(), message.size(), &directive) == true);
+    alert = manager.generateAlert(directive);
+    g_assert(alert != nullptr);
+    g_assert(manager.processDuplication(alert) == false);
+    g_assert(manager.isFull(alert) == true);
+    delete alert;
+
+    /* the timer of the directive replaces the existing one */
+    g_assert(reader.parse(DIR_TIMER, root) == true);
+    root["token"] = "token-timer3";
+    message = writer.write(root);
+    g_assert(AlertsDirectiveParser::parseSetAlert(message.c_str(), message.size(), &directive) == true);
+    alert = manager.generateAlert(directive);
+    g_assert(alert != nullptr);
+    g_assert(manager.isFull(alert) == false);
+    delete alert;
+
+    manager.reset();
+
+    /* 10,000 everyday alarms fired in a day */
+    SimulationListener listener(&manager, &clock);
+    AlertsPoolStats items;
+
+    g_assert(manager.setCapacity(10000, 10002) == true);
+    g_assert(AlertsManager::getItemPoolStats().capacity >= 10002);
+    manager.setListener(&listener);
+    items = AlertsManager::getItemPoolStats();
+
+    g_assert(reader.parse(DIR1_EVERYDAY, root) == true);
+    for (int i = 0; i < 10000; i++) {
+        int hms = (i * 7) % 86400;
+
+        root["token"] = "alarm-" + std::to_string(i);
+        snprintf(buf, sizeof(buf), "%02d:%02d:%02d", hms / 3600, hms / 60 % 60, hms % 60);
+        root["scheduledTime"] = buf;
+        g_assert(manager.add(root) == true);
+    }
+
+    root["token"] = "alarm-full";
+    root["scheduledTime"] = "23:59:59";
+    g_assert(manager.add(root) == false);
+
+    /* no heap overflow up to the capacity */
+    g_assert(AlertsManager::getItemPoolStats().overflow == items.overflow);
+
+    clock.advance(86400ULL * 1000);
+    g_assert(listener.fired.size() == 10000);
+
+    for (int i = 0; i < 10000; i++)
+        g_assert(manager.removeItem("alarm-" + std::to_string(i)) == true);
+    g_assert(manager.getAlertCount() == 0);
+}
+
+static void test_timer_wheel(void)
+{
+    AlertsTimerWheel wheel(1000);
+    std::vector<AlertsTimerWheel::Expired> expired;
+    uint64_t tick;
+
+    wheel_fired = 0;
+
+    AlertsTimerWheel::TimerId id1 = wheel.add(1001, _wheel_cb, GINT_TO_POINTER(1));
+    AlertsTimerWheel::TimerId id2 = wheel.add(1000 + 70, _wheel_cb, GINT_TO_POINTER(10));
+    AlertsTimerWheel::TimerId id3 = wheel.add(1000 + 86400 * 7, _wheel_cb, GINT_TO_POINTER(100));
+    g_assert(id1 != 0 && id2 != 0 && id3 != 0);
+    g_assert(wheel.size() == 3);
+
+    g_assert(wheel.nextExpiry(&tick) == true);
+    g_assert(tick == 1001);
+
+    /* cancel */
+    g_assert(wheel.remove(id2) == true);
+    g_assert(wheel.remove(id2) == false);
+    g_assert(wheel.size() == 2);
+
+    wheel.collect(1001, expired);
+    g_assert(expired.size() == 1);
+    g_assert(expired[0].id == id1);
+    expired[0].func(expired[0].userdata);
+    g_assert(wheel_fired == 1);
+
+    /* stale id must not match the reused node */
+    g_assert(wheel.remove(id1) == false);
+
+    /* ... even after the node is reused more than 256 times */
+    AlertsTimerWheel::TimerId reused = 0;
+    for (int i = 0; i < 300; i++) {
+        reused = wheel.add(2000, _wheel_cb, NULL);
+        if (i < 299)
+            g_assert(wheel.remove(reused) == true);
+    }
+    g_assert((uint32_t)reused == (uint32_t)id1);
+    g_assert(wheel.remove(id1) == false);
+    g_assert(wheel.contains(reused) == true);
+    g_assert(wheel.remove(reused) == true);
+
+    /* a week later (cascaded from the upper levels) */
+    expired.clear();
+    wheel.collect(1000 + 86400 * 7 - 1, expired);
+    g_assert(expired.size() == 0);
+    wheel.collect(1000 + 86400 * 7, expired);
+    g_assert(expired.size() == 1);
+    g_assert(expired[0].id == id3);
+    g_assert(wheel.size() == 0);
+    g_assert(wheel.nextExpiry(&tick) == false);
+}
+
+static void test_timer_wheel_rebase(void)
+{
+    AlertsTimerWheel wheel(1000);
+    std::vector<AlertsTimerWheel::Expired> expired;
+
+    /* same deadline: wall-clock and relative (e.g. snooze) */
+    AlertsTimerWheel::TimerId id1 = wheel.add(1100, _wheel_cb, NULL);
+    AlertsTimerWheel::TimerId id2 = wheel.add(1100, _wheel_cb, NULL, nullptr, true);
+
+    /* clock is set backward 50 ticks */
+    wheel.rebase(950, -50);
+    wheel.collect(1050, expired);
+    g_assert(expired.size() == 1);
+    g_assert(expired[0].id == id2);
+
+    expired.clear();
+    wheel.collect(1099, expired);
+    g_assert(expired.size() == 0);
+    wheel.collect(1100, expired);
+    g_assert(expired.size() == 1);
+    g_assert(expired[0].id == id1);
+
+    /* clock is set forward beyond the deadline */
+    expired.clear();
+    id1 = wheel.add(1200, _wheel_cb, NULL);
+    id2 = wheel.add(1200, _wheel_cb, NULL, nullptr, true);
+    wheel.rebase(1300, 200);
+    wheel.collect(1300, expired);
+    g_assert(expired.size() == 1);
+    g_assert(expired[0].id == id1);
+    g_assert(wheel.contains(id2) == true);
+}
+
+class TimeoutListener : public IAlertsManagerListener {
+public:
+    void onTimeout(const std::string& token) override
+    {
+        timeout++;
+    }
+    void onAssetRequireTimeout(const std::string& token) override
+    {
+        asset_timeout++;
+    }
+    void onDurationTimeout(const std::string& token) override
+    {
+        duration_timeout++;
+    }
+
+    std::atomic<int> timeout { 0 };
+    std::atomic<int> asset_timeout { 0 };
+    std::atomic<int> duration_timeout { 0 };
+};
+
+static void test_timeout(void)
+{
+    AlertsManager manager;
+    TimeoutListener listener;
+
+    manager.setListener(&listener);
+
+    /* all deadlines share the single timerfd */
+    g_assert(manager.addTimeout(1, "token-1") != 0);
+    g_assert(manager.addAssetTimeout(1, "token-1") != 0);
+    AlertTimerId src = manager.addDurationTimeout(1, "token-1");
+    g_assert(src != 0);
+    manager.removeTimeout(src);
+
+    /* the timeouts are delivered in the owner (default) context */
+    for (int i = 0; i < 300 && listener.timeout == 0; i++) {
+        g_main_context_iteration(NULL, FALSE);
+        g_usleep(10 * 1000);
+    }
+
+    g_assert(listener.timeout == 1);
+    g_assert(listener.asset_timeout == 1);
+    g_assert(listener.duration_timeout == 0);
+}
+
+static void test_timer_service(void)
+{
+    AlertsTimerService& service = AlertsTimerService::getInstance();
+    AlertsManager* managers[8];
+    TimeoutListener listener;
+    AlertsTimerServiceStats stats;
+
+    g_assert(service.getStats().clients == 0);
+
+    for (int i = 0; i < 8; i++) {
+        managers[i] = new AlertsManager();
+        managers[i]->setListener(&listener);
+    }
+
+    /* no timer thread until the first deadline */
+    stats = service.getStats();
+    g_assert(stats.clients == 8);
+    g_assert(stats.armed == 0);
+    g_assert(stats.running == false);
+
+    /* one timer thread for all the managers */
+    for (int i = 0; i < 8; i++)
+        g_assert(managers[i]->addTimeout(1, "token-" + std::to_string(i), true) != 0);
+
+    stats = service.getStats();
+    g_assert(stats.armed == 8);
+    g_assert(stats.running == true);
+
+    /* each manager gets its own timeout only */
+    for (int i = 0; i < 300 && listener.timeout < 8; i++) {
+        g_main_context_iteration(NULL, FALSE);
+        g_usleep(10 * 1000);
+    }
+    g_assert(listener.timeout == 8);
+
+    for (int i = 0; i < 8; i++)
+        delete managers[i];
+
+    stats = service.getStats();
+    g_assert(stats.clients == 0);
+    g_assert(stats.armed == 0);
+    g_assert(stats.running == false);
+}
+
+static void test_precision(void)
+{
+    AlertsManager manager;
+    TimeoutListener listener;
+    Json::Value item;
+
+    item["token"] = "precision";
+    item["scheduledTime"] = "07:00:00.250";
+    item["repeat"]["type"] = "DAILY";
+    item["alertType"] = "ALARM";
+    item["alarmResourceType"] = "MUSIC";
+    item["activation"] = false;
+
+    AlertItem* alert = manager.generateAlert(item);
+    g_assert(alert->type == ALERT_TYPE_ALARM);
+    g_assert(alert->rsrc == ALERT_RESOURCE_MUSIC);
+    g_assert(alert->frac_msec == 250);
+    g_assert(alert->hms_local_secs == 7 * 3600);
+    delete alert;
+
+    manager.setListener(&listener);
+    manager.setPrecisionMode(true);
+    g_assert(manager.isPrecisionMode() == true);
+
+    gint64 deadline = g_get_real_time() / 1000 + 300;
+    g_assert(manager.addTimeoutAt(deadline, "token-1") != 0);
+
+    for (int i = 0; i < 100 && listener.timeout == 0; i++) {
+        g_main_context_iteration(NULL, FALSE);
+        g_usleep(10 * 1000);
+    }
+
+    g_assert(listener.timeout == 1);
+
+    AlertsFireStats stats = manager.getFireStats();
+    g_assert(stats.count == 1);
+    g_assert(stats.last >= 0 && stats.last < 100);
+}
+
 int main(int argc, char* argv[])
 {
 #if !GLIB_CHECK_VERSION(2, 36, 0)
@@ -605,6 +2110,29 @@ int main(int argc, char* argv[])
     g_test_add_func("/alarm/ignore3", test_ignore3);
     g_test_add_func("/alarm/ignore4", test_ignore4);
     g_test_add_func("/alarm/ignore5", test_ignore5);
+    g_test_add_func("/alarm/ignore6", test_ignore6);
+    g_test_add_func("/alarm/duplication_index", test_duplication_index);
+    g_test_add_func("/alarm/transaction", test_transaction);
+    g_test_add_func("/alarm/snapshot", test_snapshot);
+    g_test_add_func("/alarm/journal", test_journal);
+    g_test_add_func("/alarm/token_index", test_token_index);
+    g_test_add_func("/alarm/handle", test_handle);
+    g_test_add_func("/alarm/pool", test_pool);
+    g_test_add_func("/alarm/command_queue", test_command_queue);
+    g_test_add_func("/alarm/version", test_version);
+    g_test_add_func("/alarm/context_projection", test_context_projection);
+    g_test_add_func("/alarm/directive_parser", test_directive_parser);
+    g_test_add_func("/alarm/time_parser", test_time_parser);
+    g_test_add_func("/alarm/timezone", test_timezone);
+    g_test_add_func("/alarm/local_day", test_local_day);
+    g_test_add_func("/alarm/virtual_clock", test_virtual_clock);
+    g_test_add_func("/alarm/clock_step_dispatch", test_clock_step_dispatch);
+    g_test_add_func("/alarm/capacity", test_capacity);
+    g_test_add_func("/alarm/timer_wheel", test_timer_wheel);
+    g_test_add_func("/alarm/timer_wheel_rebase", test_timer_wheel_rebase);
+    g_test_add_func("/alarm/timeout", test_timeout);
+    g_test_add_func("/alarm/timer_service", test_timer_service);
+    g_test_add_func("/alarm/precision", test_precision);
 
     return g_test_run();
 }